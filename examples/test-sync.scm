@@ -10,11 +10,6 @@ schedule(s7test,0,0)
 event_i("e",0,1)
              ")
 (csound-compile-string cs code)
-(define (run-cs p) (cond ((not (= 0 p)) p)
-                         (else
-                          (run-cs
-                           (csound-perform-ksmps cs)
-                           ))))
-(run-cs 0)
+(csound-render cs)
 (exit)
    
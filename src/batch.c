@@ -0,0 +1,218 @@
+/******************************************************************************/
+//
+// batch.c: Csound s7 parallel batch renderer
+// (c) V Lazzarini, 2025
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE
+/******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cs-s7.h"
+
+/* a manifest line: input (.csd or .scm) and optional output file */
+typedef struct {
+  char *path, *out;
+  int32_t res;  // 0 = done, -1 = not run, other = failed
+  double wall, secs;
+} BJOB;
+
+typedef struct {
+  BJOB *jobs;
+  int32_t njobs;
+  atomic_int next;
+} BATCH;
+
+typedef struct {
+  BATCH *batch;
+  s7_scheme *s7;
+  s7_pointer cs;
+  pthread_t thread;
+} BWORKER;
+
+static double now_secs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static s7_pointer batch_call(s7_scheme *sc, const char *name,
+                             s7_pointer args) {
+  return s7_call(sc, s7_name_to_value(sc, name), args);
+}
+
+static int32_t batch_setopt(s7_scheme *sc, s7_pointer cs, const char *opt) {
+  s7_pointer res = batch_call(sc, "csound-options",
+                              s7_list(sc, 2, cs, s7_make_string(sc, opt)));
+  return s7_is_integer(res) ? (int32_t) s7_integer(res) : -1;
+}
+
+/* offline output: a file if given, none otherwise */
+static int32_t batch_output(s7_scheme *sc, s7_pointer cs, BJOB *job) {
+  char opt[1024];
+  if(job->out == NULL) return batch_setopt(sc, cs, "-n");
+  snprintf(opt, 1024, "--output=%s", job->out);
+  return batch_setopt(sc, cs, opt);
+}
+
+/* Scheme jobs fail if they cannot be loaded or raise an error,
+   which is reported and does not reach the worker */
+static const char *batch_load_def =
+  "(define (batch-load path) "
+  "  (catch #t (lambda () (load path) #t) "
+  "    (lambda (type info) "
+  "      (format *stderr* \"~A: ~A ~S~%\" path type info) #f)))";
+
+/* CSD jobs are compiled and rendered here, Scheme jobs are loaded
+   with the engine in *batch-csound* and do their own rendering */
+static void batch_run(s7_scheme *sc, s7_pointer cs, BJOB *job) {
+  const char *ext = strrchr(job->path, '.');
+  s7_pointer res;
+  double t = now_secs();
+  job->res = 0;
+  batch_setopt(sc, cs, "-d");
+  batch_setopt(sc, cs, "-m0");
+  if(ext != NULL && !strcmp(ext, ".scm")) {
+    s7_define_variable(sc, "*batch-output*", job->out ?
+                       s7_make_string(sc, job->out) : s7_f(sc));
+    batch_output(sc, cs, job);
+    res = batch_call(sc, "batch-load",
+                     s7_list(sc, 1, s7_make_string(sc, job->path)));
+    if(res == s7_f(sc)) job->res = 1;
+  } else {
+    res = batch_call(sc, "csound-compile",
+                     s7_list(sc, 2, cs, s7_make_string(sc, job->path)));
+    /* CsOptions are overridden by the batch output */
+    if(!s7_is_integer(res) || (job->res = (int32_t) s7_integer(res)) == 0) {
+      batch_output(sc, cs, job);
+      res = batch_call(sc, "csound-start", s7_list(sc, 2, cs, s7_f(sc)));
+      if(!s7_is_integer(res) || (job->res = (int32_t) s7_integer(res)) == 0)
+        batch_call(sc, "csound-render", s7_list(sc, 1, cs));
+    }
+  }
+  res = batch_call(sc, "csound-time", s7_list(sc, 1, cs));
+  job->secs = s7_is_pair(res) ? s7_number_to_real(sc, s7_car(res)) : 0.;
+  job->wall = now_secs() - t;
+  /* reset the engine for the next job */
+  batch_call(sc, "csound-stop", s7_list(sc, 1, cs));
+}
+
+/* the engine is stopped and, once unreferenced, destroyed by the
+   collector, before its interpreter is freed */
+static void batch_free(BWORKER *w) {
+  s7_scheme *sc = w->s7;
+  batch_call(sc, "csound-stop", s7_list(sc, 1, w->cs));
+  s7_define_variable(sc, "*batch-csound*", s7_f(sc));
+  w->cs = NULL;
+  s7_eval_c_string(sc, "(gc)");
+  s7_free(sc);
+}
+
+static void *batch_worker(void *data) {
+  BWORKER *w = (BWORKER *) data;
+  BATCH *b = w->batch;
+  int32_t n;
+  while((n = atomic_fetch_add(&b->next, 1)) < b->njobs)
+    batch_run(w->s7, w->cs, &b->jobs[n]);
+  return NULL;
+}
+
+static int32_t batch_read(const char *manifest, BATCH *b) {
+  FILE *fp = fopen(manifest, "r");
+  char line[2048];
+  int32_t cap = 0;
+  if(fp == NULL) return -1;
+  while(fgets(line, 2048, fp) != NULL) {
+    char *path = strtok(line, " \t\r\n"), *out;
+    if(path == NULL || path[0] == '#') continue;
+    out = strtok(NULL, " \t\r\n");
+    if(b->njobs == cap) {
+      cap = cap ? 2*cap : 64;
+      b->jobs = (BJOB *) realloc(b->jobs, cap*sizeof(BJOB));
+    }
+    b->jobs[b->njobs].path = strdup(path);
+    b->jobs[b->njobs].out = out ? strdup(out) : NULL;
+    b->jobs[b->njobs].res = -1;
+    b->jobs[b->njobs].wall = b->jobs[b->njobs].secs = 0.;
+    b->njobs++;
+  }
+  fclose(fp);
+  return b->njobs;
+}
+
+int32_t cs_s7_batch(const char *manifest, int32_t nworkers) {
+  BATCH b = { NULL, 0 };
+  BWORKER *w;
+  int32_t i, failed = 0;
+  double t;
+  if(batch_read(manifest, &b) < 0) {
+    fprintf(stderr, "cs-s7: could not read manifest %s\n", manifest);
+    return -1;
+  }
+  atomic_init(&b.next, 0);
+  if(nworkers <= 0) nworkers = (int32_t) sysconf(_SC_NPROCESSORS_ONLN);
+  if(nworkers > b.njobs) nworkers = b.njobs;
+  if(nworkers < 1) nworkers = 1;
+  w = (BWORKER *) calloc(nworkers, sizeof(BWORKER));
+  /* interpreters and engines are set up here, one per worker, and
+     reused for all of its jobs */
+  for(i = 0; i < nworkers; i++) {
+    w[i].batch = &b;
+    w[i].s7 = s7_init();
+    if(cs_s7(w[i].s7) != CSOUND_SUCCESS) break;
+    s7_eval_c_string(w[i].s7, batch_load_def);
+    w[i].cs = s7_eval_c_string(w[i].s7, "(make-csound)");
+    s7_define_variable(w[i].s7, "*batch-csound*", w[i].cs);
+  }
+  if(i < nworkers) s7_free(w[i].s7);
+  nworkers = i;
+  t = now_secs();
+  for(i = 0; i < nworkers; i++)
+    pthread_create(&w[i].thread, NULL, batch_worker, &w[i]);
+  for(i = 0; i < nworkers; i++) pthread_join(w[i].thread, NULL);
+  t = now_secs() - t;
+  for(i = 0; i < b.njobs; i++) {
+    BJOB *job = &b.jobs[i];
+    if(job->res != 0) {
+      failed++;
+      fprintf(stdout, "%s: %s (%d)\n", job->path,
+              job->res < 0 ? "not run" : "failed", job->res);
+    } else
+      fprintf(stdout, "%s: %.3f s wall, %.3f s rendered, %.2fx real-time\n",
+              job->path, job->wall, job->secs,
+              job->wall > 0. ? job->secs/job->wall : 0.);
+    free(job->path);
+    free(job->out);
+  }
+  fprintf(stdout, "cs-s7: %d jobs (%d failed) on %d workers in %.3f s\n",
+          b.njobs, failed, nworkers, t);
+  for(i = 0; i < nworkers; i++) batch_free(&w[i]);
+  free(w);
+  free(b.jobs);
+  return failed;
+}
@@ -0,0 +1,289 @@
+/******************************************************************************/
+//
+// bench.c: Csound s7 interface benchmarks
+// (c) V Lazzarini, 2025
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE
+/******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "cs-s7.h"
+
+/* runs offline, printing the results as JSON:
+   cs-s7-bench [output.json] */
+
+#define SR 48000
+#define KSMPS 64
+#define CALLS 100000     // API calls per measurement
+#define OPCALLS 10000    // i-time opcode calls per instance
+#define KOPCALLS 100     // k-rate opcode calls per k-cycle
+#define KBLOCKS 200      // k-cycles per measurement
+#define REPEATS 10       // best of
+#define ENGINES 20       // engines created and stopped
+
+static const char *orc =
+  "sr = 48000\n ksmps = 64\n nchnls = 2\n 0dbfs = 1\n"
+  "instr 1\n endin\n"
+  /* i-time: empty loop, then s7eval, s7definevar, s7real */
+  "instr 10\n icnt = 0\n while icnt < p4 do\n icnt += 1\n od\n endin\n"
+  "instr 11\n icnt = 0\n while icnt < p4 do\n ires = s7eval(\"(+ 1 2)\")\n"
+  " icnt += 1\n od\n endin\n"
+  "instr 12\n icnt = 0\n while icnt < p4 do\n s7definevar(\"x\", icnt)\n"
+  " icnt += 1\n od\n endin\n"
+  "instr 13\n obj:S7obj = s7real(1.5)\n icnt = 0\n while icnt < p4 do\n"
+  " ires = s7real(obj)\n icnt += 1\n od\n endin\n"
+  /* k-rate: the same, p4 calls per k-cycle */
+  "instr 20\n kcnt = 0\n while kcnt < p4 do\n kcnt += 1\n od\n endin\n"
+  "instr 21\n kcnt = 0\n while kcnt < p4 do\n kres = s7eval(\"(+ 1 2)\")\n"
+  " kcnt += 1\n od\n endin\n"
+  "instr 22\n kcnt = 0\n while kcnt < p4 do\n s7definevar(\"x\", kcnt)\n"
+  " kcnt += 1\n od\n endin\n"
+  "instr 23\n obj:S7obj = s7real(1.5)\n kcnt = 0\n while kcnt < p4 do\n"
+  " kres = s7real(obj)\n kcnt += 1\n od\n endin\n";
+
+static s7_scheme *sc;
+static FILE *out;
+static int32_t nresults = 0;
+
+static double now_secs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* argument lists reused across calls are kept from the GC,
+   and released together */
+static s7_int kept[8];
+static int32_t nkept = 0;
+
+static s7_pointer keep(s7_pointer p) {
+  kept[nkept++] = s7_gc_protect(sc, p);
+  return p;
+}
+
+static void unkeep(void) {
+  while(nkept > 0) s7_gc_unprotect_at(sc, kept[--nkept]);
+}
+
+static s7_pointer call(const char *name, s7_pointer args) {
+  return s7_call(sc, s7_name_to_value(sc, name), args);
+}
+
+static void result(const char *name, const char *unit, double value,
+                   int64_t n) {
+  fprintf(out, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", "
+          "\"value\": %.6g, \"n\": %lld}", nresults++ ? "," : "",
+          name, unit, value, (long long) n);
+}
+
+static void options(s7_pointer cs) {
+  const char *opts[] = { "-n", "-d", "-m0" };
+  int32_t i;
+  for(i = 0; i < 3; i++)
+    call("csound-options", s7_list(sc, 2, cs, s7_make_string(sc, opts[i])));
+}
+
+/* a new engine, kept from the GC at *loc */
+static s7_pointer engine(s7_int *loc) {
+  s7_pointer cs = s7_eval_c_string(sc, "(make-csound)");
+  *loc = s7_gc_protect(sc, cs);
+  return cs;
+}
+
+static void engine_start(s7_pointer cs) {
+  options(cs);
+  call("csound-compile-string", s7_list(sc, 2, cs, s7_make_string(sc, orc)));
+  call("csound-start", s7_list(sc, 2, cs, s7_f(sc)));
+}
+
+static void event(s7_pointer cs, double instr, double dur, double p4) {
+  call("csound-event", s7_list(sc, 6, cs, s7_make_integer(sc, 0),
+                               s7_make_real(sc, instr), s7_make_real(sc, 0),
+                               s7_make_real(sc, dur), s7_make_real(sc, p4)));
+}
+
+static double perform(s7_pointer cs, int32_t blocks) {
+  s7_pointer args = keep(s7_list(sc, 1, cs));
+  s7_pointer proc = s7_name_to_value(sc, "csound-perform-ksmps");
+  double t = now_secs();
+  while(blocks--) s7_call(sc, proc, args);
+  t = now_secs() - t;
+  unkeep();
+  return t;
+}
+
+/* make-csound alone, then from options to the first k-cycle */
+static void bench_engines(void) {
+  double create = 0., start = 0., stop = 0., t;
+  int32_t i;
+  for(i = 0; i < ENGINES; i++) {
+    s7_pointer cs;
+    s7_int loc;
+    t = now_secs();
+    cs = engine(&loc);
+    create += now_secs() - t;
+    t = now_secs();
+    engine_start(cs);
+    perform(cs, 1);
+    start += now_secs() - t;
+    t = now_secs();
+    call("csound-stop", s7_list(sc, 1, cs));
+    stop += now_secs() - t;
+    s7_gc_unprotect_at(sc, loc);
+  }
+  result("engine-create", "ms", create*1e3/ENGINES, ENGINES);
+  result("engine-start", "ms", start*1e3/ENGINES, ENGINES);
+  result("engine-stop", "ms", stop*1e3/ENGINES, ENGINES);
+}
+
+static void bench_compile(s7_pointer cs) {
+  char code[64];
+  double t = now_secs();
+  int32_t i;
+  for(i = 0; i < 200; i++) {
+    snprintf(code, 64, "instr bench%d\n endin\n", i);
+    call("csound-compile-string", s7_list(sc, 2, cs,
+                                          s7_make_string(sc, code)));
+  }
+  result("compile-string", "us", (now_secs() - t)*1e6/200, 200);
+}
+
+static void bench_events(s7_pointer cs) {
+  s7_pointer proc = s7_name_to_value(sc, "csound-event");
+  s7_pointer args = keep(s7_list(sc, 6, cs, s7_make_integer(sc, 0),
+                                 s7_make_real(sc, 1), s7_make_real(sc, 0),
+                                 s7_make_real(sc, 0), s7_make_real(sc, 0)));
+  double t = now_secs();
+  int32_t i;
+  for(i = 0; i < CALLS; i++) s7_call(sc, proc, args);
+  t = now_secs() - t;
+  unkeep();
+  result("csound-event", "events/s", CALLS/t, CALLS);
+  perform(cs, 1);
+}
+
+static void bench_channels(s7_pointer cs) {
+  s7_pointer set = s7_name_to_value(sc, "csound-set-channel");
+  s7_pointer get = s7_name_to_value(sc, "csound-get-channel");
+  s7_pointer name = s7_make_string(sc, "bench");
+  s7_pointer set_args = keep(s7_list(sc, 3, cs, name, s7_make_real(sc, 0.5)));
+  s7_pointer get_args = keep(s7_list(sc, 2, cs, name));
+  s7_pointer ch, ref, ch_set;
+  double t = now_secs();
+  int32_t i;
+  for(i = 0; i < CALLS; i++) {
+    s7_call(sc, set, set_args);
+    s7_call(sc, get, get_args);
+  }
+  result("channel-roundtrip", "ns", (now_secs() - t)*1e9/CALLS, CALLS);
+  unkeep();
+  ch = call("csound-channel", s7_list(sc, 2, cs, name));
+  ref = s7_name_to_value(sc, "csound-channel-ref");
+  ch_set = s7_name_to_value(sc, "csound-channel-set!");
+  set_args = keep(s7_list(sc, 2, ch, s7_make_real(sc, 0.5)));
+  get_args = keep(s7_list(sc, 1, ch));
+  t = now_secs();
+  for(i = 0; i < CALLS; i++) {
+    s7_call(sc, ch_set, set_args);
+    s7_call(sc, ref, get_args);
+  }
+  result("channel-handle-roundtrip", "ns", (now_secs() - t)*1e9/CALLS,
+         CALLS);
+  unkeep();
+}
+
+/* best of REPEATS, for an i-time instance making n calls */
+static double itime(s7_pointer cs, int32_t instr, int32_t n) {
+  double best = 1e9, t;
+  int32_t i;
+  for(i = 0; i < REPEATS; i++) {
+    event(cs, instr, 0, n);
+    if((t = perform(cs, 1)) < best) best = t;
+  }
+  return best;
+}
+
+/* best of REPEATS, for KBLOCKS k-cycles of an instance making n calls */
+static double krate(s7_pointer cs, int32_t instr, int32_t n) {
+  double best = 1e9, t;
+  int32_t i;
+  for(i = 0; i < REPEATS; i++) {
+    event(cs, instr, -1, n);
+    perform(cs, 1);
+    if((t = perform(cs, KBLOCKS)) < best) best = t;
+    event(cs, -instr, 0, 0);
+    perform(cs, 1);
+  }
+  return best;
+}
+
+static void bench_opcodes(s7_pointer cs) {
+  const char *names[] = { "s7eval", "s7definevar", "s7real" };
+  char name[64];
+  double base = itime(cs, 10, OPCALLS);
+  int32_t i;
+  for(i = 0; i < 3; i++) {
+    snprintf(name, 64, "%s-i", names[i]);
+    result(name, "ns/call",
+           (itime(cs, 11 + i, OPCALLS) - base)*1e9/OPCALLS, OPCALLS);
+  }
+  base = krate(cs, 20, KOPCALLS);
+  for(i = 0; i < 3; i++) {
+    snprintf(name, 64, "%s-k", names[i]);
+    result(name, "ns/call",
+           (krate(cs, 21 + i, KOPCALLS) - base)*1e9/(KOPCALLS*KBLOCKS),
+           KOPCALLS*KBLOCKS);
+  }
+}
+
+int main(int argc, char **argv) {
+  s7_pointer cs;
+  s7_int loc;
+  out = stdout;
+  if(argc > 1 && (out = fopen(argv[1], "w")) == NULL) {
+    fprintf(stderr, "cs-s7-bench: could not open %s\n", argv[1]);
+    return 1;
+  }
+  sc = s7_init();
+  if(cs_s7(sc) != CSOUND_SUCCESS) {
+    fprintf(stderr, "cs-s7-bench: could not initialise Csound\n");
+    return 1;
+  }
+  fprintf(out, "{\n  \"sr\": %d,\n  \"ksmps\": %d,\n  \"results\": [",
+          SR, KSMPS);
+  bench_engines();
+  cs = engine(&loc);
+  engine_start(cs);
+  bench_compile(cs);
+  bench_events(cs);
+  bench_channels(cs);
+  bench_opcodes(cs);
+  fprintf(out, "\n  ]\n}\n");
+  if(out != stdout) fclose(out);
+  call("csound-stop", s7_list(sc, 1, cs));
+  s7_gc_unprotect_at(sc, loc);
+  return 0;
+}
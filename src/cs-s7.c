@@ -25,22 +25,1300 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE
 /******************************************************************************/
+#include <time.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "cs-s7.h"
 
+static s7_pointer code_form(CSOUND *csound, s7_scheme *s7, const char *code);
+typedef struct S7CTX_ S7CTX;
+static void defs_replicate(S7CTX *ctx);
+
+/******************************************************************************/
+/**
+ * per-engine state, kept in the _S7CTX_ global variable
+ **/
+
+enum { GC_NORMAL = 0, GC_KCYCLE };
+
+/* lock-free single-producer single-consumer queue */
+#define QSIZE 256
+typedef struct {
+  void *item[QSIZE];
+  atomic_uint head, tail;
+} SPSC;
+
+static bool spsc_push(SPSC *q, void *item) {
+  uint32_t t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  if(t - atomic_load_explicit(&q->head, memory_order_acquire) == QSIZE)
+    return false;
+  q->item[t & (QSIZE-1)] = item;
+  atomic_store_explicit(&q->tail, t + 1, memory_order_release);
+  return true;
+}
+
+static void *spsc_pop(SPSC *q) {
+  void *item;
+  uint32_t h = atomic_load_explicit(&q->head, memory_order_relaxed);
+  if(h == atomic_load_explicit(&q->tail, memory_order_acquire))
+    return NULL;
+  item = q->item[h & (QSIZE-1)];
+  atomic_store_explicit(&q->head, h + 1, memory_order_release);
+  return item;
+}
+
+static inline bool spsc_empty(SPSC *q) {
+  return atomic_load_explicit(&q->head, memory_order_relaxed) ==
+    atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+/* lock-free (intrusive) multiple-producer single-consumer queue */
+typedef struct mpsc_node {
+  _Atomic(struct mpsc_node *) next;
+} MPSC_NODE;
+
+typedef struct {
+  _Atomic(MPSC_NODE *) head;
+  MPSC_NODE *tail;
+  MPSC_NODE stub;
+} MPSC;
+
+static void mpsc_init(MPSC *q) {
+  atomic_store(&q->stub.next, NULL);
+  atomic_store(&q->head, &q->stub);
+  q->tail = &q->stub;
+}
+
+static inline bool mpsc_empty(MPSC *q) {
+  return q->tail == &q->stub &&
+    atomic_load_explicit(&q->stub.next, memory_order_acquire) == NULL;
+}
+
+static void mpsc_push(MPSC *q, MPSC_NODE *node) {
+  MPSC_NODE *prev;
+  atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+  prev = atomic_exchange_explicit(&q->head, node, memory_order_acq_rel);
+  atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+static MPSC_NODE *mpsc_pop(MPSC *q) {
+  MPSC_NODE *tail = q->tail;
+  MPSC_NODE *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  if(tail == &q->stub) {
+    if(next == NULL) return NULL;
+    q->tail = next;
+    tail = next;
+    next = atomic_load_explicit(&next->next, memory_order_acquire);
+  }
+  if(next != NULL) {
+    q->tail = next;
+    return tail;
+  }
+  /* a push is in progress */
+  if(tail != atomic_load_explicit(&q->head, memory_order_acquire))
+    return NULL;
+  mpsc_push(q, &q->stub);
+  next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  if(next != NULL) {
+    q->tail = next;
+    return tail;
+  }
+  return NULL;
+}
+
+/* real-time pool: free heap cells reserved for the engine thread.
+   The pool goes from READY to EXHAUSTED (no s7 calls made) when
+   the free heap is found below it at a k-cycle boundary. The
+   engine then leaves the interpreter alone, and the refill thread
+   (or the thread taking the interpreter back when performance
+   stops or pauses) takes it over as REFILLING, collects and grows
+   the heap, and hands it back as READY. */
+enum { POOL_READY = 0, POOL_EXHAUSTED, POOL_REFILLING };
+
+typedef struct {
+  s7_int cells;           /* 0 if the pool is not in use */
+  atomic_int state;
+  _Atomic uint64_t skipped; /* s7 calls not made */
+  _Atomic uint64_t refills;
+  atomic_bool running;
+  void *thread;           /* refill thread */
+} S7POOL;
+
+/* profiling records, one for each instrument, opcode
+   and code string */
+typedef struct s7prof {
+  struct s7prof *next;
+  int32_t insno;
+  const char *opname;
+  char *code;
+  _Atomic uint64_t calls, ns, max_ns, cells;
+} S7PROF;
+
+/* s7async jobs, owned by the opcode instance, except when the
+   instance goes while its job is queued or running (ABANDONED),
+   in which case the worker frees it */
+enum { JOB_IDLE = 0, JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_ABANDONED,
+       JOB_FAILED, JOB_DETACHED };
+
+typedef struct {
+  MPSC_NODE node;
+  atomic_int state;
+  char *result;  /* malloc'd by the worker */
+  char code[];
+} S7JOB;
+
+/* timestamped events, kept by the performance thread in a
+   heap ordered by frame and dispatched in the block they fall
+   in; the submitting side frees each one once it is done, and
+   keeps no more pending than the heap holds */
+typedef struct s7evt {
+  MPSC_NODE node;      /* intake */
+  struct s7evt *next;  /* submission list */
+  atomic_bool done;
+  int64_t frame;
+  int32_t type;
+  int64_t n;
+  MYFLT p[];
+} S7EVT;
+
+#define SCHED_SIZE 4096
+typedef struct {
+  MPSC in;
+  S7EVT **heap;
+  int32_t len;
+} S7SCHED;
+
+/* automation lanes: ramp segments are queued by the submitting
+   thread and rendered by the engine thread, at k-cycle
+   boundaries, into a block of samples read by s7ramp */
+#define RAMP_LANES 64
+#define RAMP_QSIZE 64
+#define RAMP_NAME 64  /* names are shorter than this */
+enum { LANE_FREE = 0, LANE_CLAIMED, LANE_READY };
+
+typedef struct {
+  double target, dur, curve;
+} RAMPSEG;
+
+typedef struct {
+  atomic_int state;
+  char name[RAMP_NAME];
+  RAMPSEG seg[RAMP_QSIZE];  /* segment queue */
+  atomic_uint head, tail;
+  double value, start, target, curve;
+  int64_t pos, len;         /* current segment, samples */
+  bool active;
+  MYFLT *buf;               /* allocated by s7ramp at init-time */
+  uint32_t size;
+} RAMPLANE;
+
+/* background worker for s7async, with its own interpreter */
+typedef struct {
+  s7_scheme *s7;
+  MPSC jobs;
+  atomic_bool running;
+  void *thread;
+} S7ASYNC;
+
+/* commands sent to the engine, run at k-cycle boundaries */
+enum { CMD_EVAL = 0, CMD_EVENTS, CMD_FORM, CMD_CALL };
+
+typedef struct {
+  int32_t kind;
+  char *code;
+  char *result;  /* malloc'd by the engine thread */
+  s7_pointer form, env, value;  /* CMD_FORM: value is protected */
+  s7_int loc;    /* by the engine thread at loc */
+  void (*call)(void *);  /* CMD_CALL: run on the engine thread */
+  void *arg;
+  int32_t type;  /* CMD_EVENTS: event type and, for each */
+  int64_t size;  /* event, the number of pfields followed */
+  MYFLT data[];  /* by the pfields */
+} S7CMD;
+
+struct S7CTX_ {
+  CSOUND *csound;
+  s7_scheme *s7;
+  s7_scheme **ipool;     /* interpreters for worker threads */
+  int32_t npool;
+  atomic_int claimed;    /* worker thread slots taken */
+  s7_pointer *ifree;     /* free heap probes for the pool */
+  void *defs;            /* k-rate s7definevar instances */
+  atomic_bool profiling;
+  _Atomic(S7PROF *) prof;
+  int32_t gc_mode;
+  uint64_t gc_budget;    /* ns */
+  uint64_t gc_cost;      /* duration of last collection, ns */
+  s7_int gc_low;         /* collect below this number of free cells */
+  s7_int heap_free;      /* free cells at last k-cycle boundary */
+  s7_pointer free_form, gc_form;
+  uint64_t gc_runs, gc_deferred;
+  bool gc_held;          /* collections switched off for performance */
+  SPSC cmds, done;       /* command and completion queues */
+  SPSC evts, evdone;     /* the same, for csound-events batches */
+  S7POOL pool;
+  S7ASYNC async;
+  S7SCHED sched;
+  RAMPLANE lanes[RAMP_LANES];
+  atomic_int nlanes;
+};
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* bulk conversions between s7 doubles and MYFLT, written as
+   plain loops over restrict pointers so they are vectorised */
+static inline void copy_to_myflt(MYFLT *restrict dst,
+                                 const s7_double *restrict src, int64_t n) {
+  int64_t i;
+  for(i = 0; i < n; i++) dst[i] = (MYFLT) src[i];
+}
+
+static inline void copy_from_myflt(s7_double *restrict dst,
+                                   const MYFLT *restrict src, int64_t n) {
+  int64_t i;
+  for(i = 0; i < n; i++) dst[i] = (s7_double) src[i];
+}
+
+static inline S7CTX *get_ctx(CSOUND *csound) {
+  return (S7CTX *) csound->QueryGlobalVariable(csound, "_S7CTX_");
+}
+
+/* opcode access to the engine state and interpreter */
+static inline void op_ctx(CSOUND *csound, S7CTX **ctx, s7_scheme **s7) {
+  if(*ctx == NULL) {
+    *ctx = get_ctx(csound);
+    *s7 = (*ctx)->s7;
+  }
+}
+
+/* interpreter pool for multithreaded performance: the engine
+   thread (which runs the k-cycle callback) uses slot 0, the
+   engine interpreter, and worker threads claim the other slots
+   on first use. Slot -1 means no interpreter is available. */
+static _Thread_local S7CTX *slot_ctx = NULL;
+static _Thread_local int32_t slot_idx = 0;
+
+static inline int32_t thread_slot(S7CTX *ctx) {
+  if(LIKELY(ctx->npool == 0)) return 0;
+  if(UNLIKELY(slot_ctx != ctx)) {
+    int32_t n = atomic_fetch_add(&ctx->claimed, 1);
+    slot_ctx = ctx;
+    slot_idx = n < ctx->npool ? n + 1 : -1;
+  }
+  return slot_idx;
+}
+
+static inline s7_scheme *slot_interp(S7CTX *ctx, int32_t slot) {
+  return slot == 0 ? ctx->s7 : ctx->ipool[slot-1];
+}
+
+static s7_pointer read_text(s7_scheme *s7, const char *text) {
+  s7_pointer port = s7_open_input_string(s7, text), obj;
+  obj = s7_read(s7, port);
+  s7_close_input_port(s7, port);
+  return obj;
+}
+
+/* defines name in all interpreters other than the one in slot,
+   copying obj from it; only when no worker thread is running */
+static void pool_define(S7CTX *ctx, int32_t slot, const char *name,
+                        s7_pointer obj) {
+  char *text = NULL;
+  int32_t i;
+  for(i = 0; i <= ctx->npool; i++) {
+    s7_scheme *to = slot_interp(ctx, i);
+    if(i == slot) continue;
+    if(s7_is_real(obj) && !s7_is_rational(obj))
+      s7_define_variable(to, name, s7_make_real(to, s7_real(obj)));
+    else {
+      if(text == NULL)
+        text = s7_object_to_c_string(slot_interp(ctx, slot), obj);
+      s7_define_variable(to, name, read_text(to, text));
+    }
+  }
+  free(text);
+}
+
+/* code strings are evaluated as a (begin ...) form */
+static s7_pointer read_code(s7_scheme *s7, const char *code) {
+  size_t len = strlen(code) + 10;
+  char *src = (char *) malloc(len);
+  s7_pointer form;
+  snprintf(src, len, "(begin\n%s\n)", code);
+  form = read_text(s7, src);
+  free(src);
+  return form;
+}
+
+static inline bool is_begin(s7_pointer form) {
+  return s7_is_pair(form) && s7_is_symbol(s7_car(form)) &&
+    !strcmp(s7_symbol_name(s7_car(form)), "begin");
+}
+
+/* top-level definitions are the define forms, matched by name */
+static const char *def_forms[] = {
+  "define", "define*", "define-macro", "define-macro*", "define-bacro",
+  "define-bacro*", "define-constant", "define-expansion",
+  "define-expansion*", NULL
+};
+
+static bool is_definition(s7_pointer form) {
+  const char *op;
+  int32_t i;
+  if(!s7_is_pair(form) || !s7_is_symbol(s7_car(form))) return false;
+  op = s7_symbol_name(s7_car(form));
+  for(i = 0; def_forms[i] != NULL; i++)
+    if(!strcmp(op, def_forms[i])) return true;
+  return false;
+}
+
+/* top-level definitions made in an interpreter are logged in
+   order in *s7eval-definitions* (most recent first, without
+   repeats), to be replayed in each interpreter of the pool; a
+   definition made again is moved to the front, so that it is
+   replayed after those it may depend on */
+static void defs_log(s7_scheme *s7, s7_pointer form) {
+  s7_pointer log, f, prev = NULL;
+  if(is_begin(form)) {
+    for(f = s7_cdr(form); s7_is_pair(f); f = s7_cdr(f))
+      defs_log(s7, s7_car(f));
+    return;
+  }
+  if(!is_definition(form)) return;
+  log = s7_name_to_value(s7, "*s7eval-definitions*");
+  if(!s7_is_pair(log)) log = s7_nil(s7);
+  for(f = log; s7_is_pair(f); prev = f, f = s7_cdr(f))
+    if(s7_is_equal(s7, s7_car(f), form)) {
+      if(prev == NULL) log = s7_cdr(f);
+      else s7_set_cdr(prev, s7_cdr(f));
+      break;
+    }
+  s7_define_variable(s7, "*s7eval-definitions*", s7_cons(s7, form, log));
+}
+
+static void async_detach(S7CTX *ctx, const char *code);
+
+/* evaluates the definitions in a form in the pool and in the
+   s7async worker, if any */
+static void pool_replicate(S7CTX *ctx, s7_pointer form) {
+  s7_pointer f;
+  int32_t i;
+  if(is_begin(form)) {
+    for(f = s7_cdr(form); s7_is_pair(f); f = s7_cdr(f))
+      pool_replicate(ctx, s7_car(f));
+  }
+  else if((ctx->npool > 0 || ctx->async.thread != NULL) &&
+          is_definition(form)) {
+    char *text = s7_object_to_c_string(ctx->s7, form);
+    for(i = 0; i < ctx->npool; i++)
+      s7_eval_c_string(ctx->ipool[i], text);
+    async_detach(ctx, text);
+    free(text);
+  }
+}
+
+/* replays the definitions logged in the engine interpreter,
+   in order, in n other interpreters */
+static void defs_replay(S7CTX *ctx, s7_scheme **to, int32_t n) {
+  s7_pointer log, f;
+  s7_int loc;
+  int32_t i;
+  log = s7_name_to_value(ctx->s7, "*s7eval-definitions*");
+  if(!s7_is_pair(log)) return;
+  log = s7_reverse(ctx->s7, log);
+  loc = s7_gc_protect(ctx->s7, log);
+  for(f = log; s7_is_pair(f); f = s7_cdr(f)) {
+    char *text = s7_object_to_c_string(ctx->s7, s7_car(f));
+    for(i = 0; i < n; i++) s7_eval_c_string(to[i], text);
+    free(text);
+  }
+  s7_gc_unprotect_at(ctx->s7, loc);
+}
+
+/* creates one interpreter for each worker thread in the
+   performance (-j N), before the engine starts, replaying
+   the definitions logged in the engine interpreter */
+static int32_t ipool_setup(CSOUND *csound) {
+  S7CTX *ctx = get_ctx(csound);
+  int32_t i, n = csound->oparms->numThreads - 1;
+  if(ctx == NULL || ctx->npool > 0 || n < 1) return OK;
+  ctx->ipool = (s7_scheme **) csound->Calloc(csound, n*sizeof(s7_scheme *));
+  ctx->ifree = (s7_pointer *) csound->Calloc(csound, n*sizeof(s7_pointer));
+  for(i = 0; i < n; i++) {
+    ctx->ipool[i] = s7_init();
+    ctx->ifree[i] = code_form(csound, ctx->ipool[i],
+                              "(*s7* 'free-heap-size)");
+  }
+  defs_replay(ctx, ctx->ipool, n);
+  atomic_store(&ctx->claimed, 0);
+  ctx->npool = n;
+  return OK;
+}
+
+static void ipool_free(CSOUND *csound, S7CTX *ctx) {
+  int32_t i, n = ctx->npool;
+  ctx->npool = 0;
+  ctx->defs = NULL;
+  for(i = 0; i < n; i++) s7_free(ctx->ipool[i]);
+  if(ctx->ipool != NULL) csound->Free(csound, ctx->ipool);
+  if(ctx->ifree != NULL) csound->Free(csound, ctx->ifree);
+  ctx->ipool = NULL;
+  ctx->ifree = NULL;
+}
+
+static inline s7_int heap_free(S7CTX *ctx) {
+  return s7_integer(s7_eval(ctx->s7, ctx->free_form, s7_rootlet(ctx->s7)));
+}
+
+/* in pool mode, s7 is only called from the engine thread if the
+   pool is ready, as found at the last k-cycle boundary, so the
+   check itself does not touch the interpreter (worker threads use
+   interpreters of their own) */
+static inline bool rt_ok(S7CTX *ctx) {
+  if(LIKELY(ctx->pool.cells == 0)) return true;
+  if(ctx->npool > 0 && (slot_ctx != ctx || slot_idx != 0)) return true;
+  if(atomic_load_explicit(&ctx->pool.state, memory_order_acquire)
+     == POOL_READY) return true;
+  atomic_fetch_add_explicit(&ctx->pool.skipped, 1, memory_order_relaxed);
+  return false;
+}
+
+/* opcode profiling: calls, wall time and (approximate) s7
+   allocations, recorded only while profiling is on, for
+   instances initialised with profiling on */
+typedef struct {
+  uint64_t t;
+  s7_int cells;
+} PROFT;
+
+static inline s7_int slot_free(S7CTX *ctx, int32_t slot) {
+  s7_scheme *s7 = slot_interp(ctx, slot);
+  s7_pointer form = slot == 0 ? ctx->free_form : ctx->ifree[slot-1];
+  return s7_integer(s7_eval(s7, form, s7_rootlet(s7)));
+}
+
+static inline bool prof_on(S7CTX *ctx, S7PROF *r) {
+  return UNLIKELY(r != NULL) &&
+    atomic_load_explicit(&ctx->profiling, memory_order_relaxed);
+}
+
+static void prof_start(S7CTX *ctx, int32_t slot, PROFT *t) {
+  t->cells = slot_free(ctx, slot);
+  t->t = now_ns();
+}
+
+static void prof_end(S7CTX *ctx, S7PROF *r, int32_t slot, PROFT *t) {
+  uint64_t ns = now_ns() - t->t, max;
+  s7_int cells = t->cells - slot_free(ctx, slot);
+  atomic_fetch_add_explicit(&r->calls, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&r->ns, ns, memory_order_relaxed);
+  /* negative if the heap was collected in the call */
+  if(cells > 0)
+    atomic_fetch_add_explicit(&r->cells, cells, memory_order_relaxed);
+  max = atomic_load_explicit(&r->max_ns, memory_order_relaxed);
+  while(ns > max && !atomic_compare_exchange_weak(&r->max_ns, &max, ns));
+}
+
+/* finds or adds the record for an opcode instance, at init-time */
+static S7PROF *prof_find(CSOUND *csound, S7CTX *ctx, OPDS *h,
+                         const char *opname, const char *code) {
+  S7PROF *r;
+  int32_t insno = h->insdshead != NULL ? h->insdshead->insno : 0;
+  if(!atomic_load_explicit(&ctx->profiling, memory_order_relaxed))
+    return NULL;
+  for(r = atomic_load(&ctx->prof); r != NULL; r = r->next)
+    if(r->insno == insno && !strcmp(r->opname, opname) &&
+       !strcmp(r->code, code)) return r;
+  r = (S7PROF *) csound->Calloc(csound, sizeof(S7PROF));
+  r->insno = insno;
+  r->opname = opname;
+  r->code = (char *) csound->Malloc(csound, strlen(code) + 1);
+  strcpy(r->code, code);
+  r->next = atomic_load(&ctx->prof);
+  atomic_store(&ctx->prof, r);
+  return r;
+}
+
+/* switching profiling on clears the records */
+static void prof_enable(S7CTX *ctx, bool on) {
+  S7PROF *r;
+  if(on)
+    for(r = atomic_load(&ctx->prof); r != NULL; r = r->next) {
+      atomic_store(&r->calls, 0);
+      atomic_store(&r->ns, 0);
+      atomic_store(&r->max_ns, 0);
+      atomic_store(&r->cells, 0);
+    }
+  atomic_store(&ctx->profiling, on);
+}
+
+static void prof_free(CSOUND *csound, S7CTX *ctx) {
+  S7PROF *r = atomic_load(&ctx->prof), *next;
+  atomic_store(&ctx->profiling, false);
+  atomic_store(&ctx->prof, NULL);
+  for(; r != NULL; r = next) {
+    next = r->next;
+    csound->Free(csound, r->code);
+    csound->Free(csound, r);
+  }
+}
+
+/* GC holds: collections are switched off in an interpreter while
+   any engine using it performs, counted per interpreter so that
+   engines sharing one do not switch it back on for each other */
+typedef struct gchold {
+  struct gchold *next;
+  s7_scheme *s7;
+  int32_t count;
+} GCHOLD;
+
+static GCHOLD *gc_holds = NULL;
+static pthread_mutex_t gc_holds_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* takes or releases the hold of an engine; the last release
+   switches collections back on and, optionally, collects */
+static void gc_hold(S7CTX *ctx, bool on, bool collect) {
+  GCHOLD *h;
+  if(ctx->gc_held == on) return;
+  ctx->gc_held = on;
+  pthread_mutex_lock(&gc_holds_lock);
+  for(h = gc_holds; h != NULL && h->s7 != ctx->s7; h = h->next);
+  if(h == NULL) {
+    h = (GCHOLD *) calloc(1, sizeof(GCHOLD));
+    h->s7 = ctx->s7;
+    h->next = gc_holds;
+    gc_holds = h;
+  }
+  if(on) {
+    if(h->count++ == 0) s7_gc_on(ctx->s7, false);
+  } else if(--h->count == 0) {
+    s7_gc_on(ctx->s7, true);
+    if(collect) s7_eval(ctx->s7, ctx->gc_form, s7_rootlet(ctx->s7));
+  }
+  pthread_mutex_unlock(&gc_holds_lock);
+}
+
+static void pool_settle(S7CTX *ctx);
+
+/* performance start/end, for the modes that hold the GC, and
+   for the pool, which is settled when the engine stops using
+   the interpreter */
+static inline void gc_perf(S7CTX *ctx, bool on, bool collect) {
+  if(on && ctx->gc_mode == GC_NORMAL && ctx->pool.cells == 0) return;
+  if(!on && ctx->pool.cells > 0) pool_settle(ctx);
+  gc_hold(ctx, on, collect);
+}
+
+/* collects, leaving the GC switched off if an engine holds it */
+static void gc_collect(S7CTX *ctx) {
+  GCHOLD *h;
+  pthread_mutex_lock(&gc_holds_lock);
+  for(h = gc_holds; h != NULL && h->s7 != ctx->s7; h = h->next);
+  s7_gc_on(ctx->s7, true);
+  s7_eval(ctx->s7, ctx->gc_form, s7_rootlet(ctx->s7));
+  if(h != NULL && h->count > 0) s7_gc_on(ctx->s7, false);
+  pthread_mutex_unlock(&gc_holds_lock);
+}
+
+/* in GC_KCYCLE mode, s7 collections are switched off while the
+   engine performs and only run at k-cycle boundaries, when the
+   heap is running low, if the cycle was idle (nothing allocated)
+   or the last collection fitted the time budget. Otherwise it is
+   deferred, but only down to half the threshold, below which it
+   runs anyway, so that the heap is not grown by the engine thread
+   (unless a single cycle takes more than that). */
+static void gc_schedule(S7CTX *ctx) {
+  s7_scheme *s7 = ctx->s7;
+  s7_int cells = heap_free(ctx);
+  /* the probe itself takes a few cells */
+  bool idle = cells + 8 >= ctx->heap_free;
+  ctx->heap_free = cells;
+  if(cells < ctx->gc_low) {
+    if(idle || ctx->gc_cost <= ctx->gc_budget || cells < ctx->gc_low/2) {
+      uint64_t t = now_ns();
+      s7_gc_on(s7, true);
+      s7_eval(s7, ctx->gc_form, s7_rootlet(s7));
+      s7_gc_on(s7, false);
+      ctx->gc_cost = now_ns() - t;
+      ctx->gc_runs++;
+    } else ctx->gc_deferred++;
+  }
+}
+
+/* collects and, if needed, grows the heap to twice the pool size */
+static void pool_fill(S7CTX *ctx) {
+  gc_collect(ctx);
+  if(heap_free(ctx) < 2*ctx->pool.cells) {
+    char code[96];
+    snprintf(code, 96, "(set! (*s7* 'heap-size) (+ (*s7* 'heap-size) %lld))",
+             (long long) (2*ctx->pool.cells));
+    s7_eval_c_string(ctx->s7, code);
+  }
+  atomic_fetch_add(&ctx->pool.refills, 1);
+}
+
+/* engine thread side, at k-cycle boundaries: a low pool is left
+   exhausted for the refill thread; returns false until it is
+   ready again */
+static bool pool_cycle(S7CTX *ctx) {
+  S7POOL *pool = &ctx->pool;
+  if(atomic_load_explicit(&pool->state, memory_order_acquire)
+     != POOL_READY) return false;
+  if(heap_free(ctx) >= pool->cells) return true;
+  atomic_store_explicit(&pool->state, POOL_EXHAUSTED, memory_order_release);
+  return false;
+}
+
+/* takes the interpreter over if the engine left the pool exhausted */
+static void pool_refill(S7CTX *ctx) {
+  int32_t state = POOL_EXHAUSTED;
+  if(atomic_compare_exchange_strong(&ctx->pool.state, &state,
+                                    POOL_REFILLING)) {
+    pool_fill(ctx);
+    atomic_store_explicit(&ctx->pool.state, POOL_READY,
+                          memory_order_release);
+  }
+}
+
+static uintptr_t pool_thread(void *data) {
+  S7CTX *ctx = (S7CTX *) data;
+  struct timespec ts = { 0, 1000000 };
+  while(atomic_load(&ctx->pool.running)) {
+    pool_refill(ctx);
+    nanosleep(&ts, NULL);
+  }
+  return 0;
+}
+
+/* when the engine stops performing (or pauses, or ends a block in
+   synchronous mode), the calling thread waits for a refill in
+   progress, or does a pending one itself, before using the
+   interpreter */
+static void pool_settle(S7CTX *ctx) {
+  struct timespec ts = { 0, 100000 };
+  for(;;) {
+    pool_refill(ctx);
+    if(atomic_load(&ctx->pool.state) != POOL_REFILLING) break;
+    nanosleep(&ts, NULL);
+  }
+}
+
+static void pool_stop(CSOUND *csound, S7CTX *ctx) {
+  if(ctx->pool.thread == NULL) return;
+  atomic_store(&ctx->pool.running, false);
+  csound->JoinThread(ctx->pool.thread);
+  ctx->pool.thread = NULL;
+}
+
+/* a printed result can be read back unless it holds an object
+   printed as #<...> outside a string */
+static bool readable(const char *text) {
+  bool str = false;
+  for(; *text != '\0'; text++) {
+    if(str) {
+      if(*text == '\\' && text[1] != '\0') text++;
+      else if(*text == '"') str = false;
+    }
+    else if(*text == '"') str = true;
+    else if(*text == '#' && text[1] == '\\' && text[2] != '\0') text += 2;
+    else if(*text == '#' && text[1] == '<') return false;
+  }
+  return true;
+}
+
+static uintptr_t async_worker(void *data) {
+  S7ASYNC *w = (S7ASYNC *) data;
+  struct timespec ts = { 0, 1000000 };
+  S7JOB *job;
+  while(atomic_load(&w->running)) {
+    while((job = (S7JOB *) mpsc_pop(&w->jobs)) != NULL) {
+      int32_t state = JOB_QUEUED;
+      free(job->result);
+      job->result = NULL;
+      if(atomic_load(&job->state) == JOB_DETACHED) {
+        s7_eval_c_string(w->s7, job->code);
+        free(job);
+        continue;
+      }
+      if(!atomic_compare_exchange_strong(&job->state, &state, JOB_RUNNING)) {
+        free(job);
+        continue;
+      }
+      job->result = s7_object_to_c_string(w->s7,
+                                          s7_eval_c_string(w->s7, job->code));
+      state = JOB_RUNNING;
+      if(!atomic_compare_exchange_strong(&job->state, &state,
+                                         readable(job->result) ?
+                                         JOB_DONE : JOB_FAILED)) {
+        free(job->result);
+        free(job);
+      }
+    }
+    nanosleep(&ts, NULL);
+  }
+  return 0;
+}
+
+/* queues code for the worker to evaluate, with no instance
+   waiting for its result */
+static void async_detach(S7CTX *ctx, const char *code) {
+  size_t len = strlen(code) + 1;
+  S7JOB *job;
+  if(ctx->async.thread == NULL) return;
+  job = (S7JOB *) calloc(1, sizeof(S7JOB) + len);
+  memcpy(job->code, code, len);
+  atomic_store(&job->state, JOB_DETACHED);
+  mpsc_push(&ctx->async.jobs, &job->node);
+}
+
+/* the worker is started by the first s7async instance, with
+   the definitions logged so far replayed in its interpreter */
+static bool async_start(CSOUND *csound, S7CTX *ctx) {
+  S7ASYNC *w = &ctx->async;
+  if(w->thread != NULL) return true;
+  w->s7 = s7_init();
+  defs_replay(ctx, &w->s7, 1);
+  mpsc_init(&w->jobs);
+  atomic_store(&w->running, true);
+  w->thread = csound->CreateThread(async_worker, w);
+  return w->thread != NULL;
+}
+
+static void async_stop(CSOUND *csound, S7CTX *ctx) {
+  S7ASYNC *w = &ctx->async;
+  S7JOB *job;
+  if(w->thread == NULL) return;
+  atomic_store(&w->running, false);
+  csound->JoinThread(w->thread);
+  w->thread = NULL;
+  /* jobs left in the queue go back to their instances */
+  while((job = (S7JOB *) mpsc_pop(&w->jobs)) != NULL) {
+    int32_t state = JOB_QUEUED;
+    if(!atomic_compare_exchange_strong(&job->state, &state, JOB_IDLE)) {
+      free(job->result);
+      free(job);
+    }
+  }
+  s7_free(w->s7);
+  w->s7 = NULL;
+}
+
+static void heap_push(S7SCHED *q, S7EVT *e) {
+  int32_t i = q->len++;
+  while(i > 0 && q->heap[(i-1)/2]->frame > e->frame) {
+    q->heap[i] = q->heap[(i-1)/2];
+    i = (i-1)/2;
+  }
+  q->heap[i] = e;
+}
+
+static S7EVT *heap_pop(S7SCHED *q) {
+  S7EVT *top = q->heap[0], *last = q->heap[--q->len];
+  int32_t i = 0, c;
+  while((c = 2*i + 1) < q->len) {
+    if(c + 1 < q->len && q->heap[c+1]->frame < q->heap[c]->frame) c++;
+    if(last->frame <= q->heap[c]->frame) break;
+    q->heap[i] = q->heap[c];
+    i = c;
+  }
+  q->heap[i] = last;
+  return top;
+}
+
+/* moves new events into the heap and dispatches those falling
+   in the current block, offsetting their start (p2) to the
+   frame they are stamped with */
+static void sched_cycle(S7CTX *ctx) {
+  S7SCHED *q = &ctx->sched;
+  CSOUND *csound = ctx->csound;
+  int64_t now = csound->GetCurrentTimeSamples(csound);
+  int64_t end = now + csound->GetKsmps(csound);
+  MYFLT sr = csound->GetSr(csound);
+  S7EVT *e;
+  while(q->len < SCHED_SIZE && (e = (S7EVT *) mpsc_pop(&q->in)) != NULL)
+    heap_push(q, e);
+  while(q->len > 0 && q->heap[0]->frame < end) {
+    e = heap_pop(q);
+    if(e->n > 1 && e->frame > now) e->p[1] += (e->frame - now)/sr;
+#ifndef BUILDING_MODULE
+    csoundEvent(csound, e->type, e->p, e->n, 0);
+#endif
+    atomic_store_explicit(&e->done, true, memory_order_release);
+  }
+}
+
+/* finds a lane by name, optionally claiming a new one; names
+   too long to be stored are not accepted */
+static RAMPLANE *lane_find(S7CTX *ctx, const char *name, bool create) {
+  int32_t i;
+  if(strlen(name) >= RAMP_NAME) return NULL;
+  for(i = 0; i < RAMP_LANES; i++) {
+    RAMPLANE *lane = &ctx->lanes[i];
+    int32_t state = atomic_load_explicit(&lane->state, memory_order_acquire);
+    if(state == LANE_READY && !strcmp(lane->name, name)) return lane;
+    if(state == LANE_FREE && create &&
+       atomic_compare_exchange_strong(&lane->state, &state, LANE_CLAIMED)) {
+      strcpy(lane->name, name);
+      atomic_fetch_add(&ctx->nlanes, 1);
+      atomic_store_explicit(&lane->state, LANE_READY, memory_order_release);
+      return lane;
+    }
+  }
+  return NULL;
+}
+
+static bool lane_push(RAMPLANE *lane, double target, double dur,
+                      double curve) {
+  uint32_t t = atomic_load_explicit(&lane->tail, memory_order_relaxed);
+  if(t - atomic_load_explicit(&lane->head, memory_order_acquire)
+     == RAMP_QSIZE) return false;
+  lane->seg[t % RAMP_QSIZE] = (RAMPSEG) { target, dur, curve };
+  atomic_store_explicit(&lane->tail, t + 1, memory_order_release);
+  return true;
+}
+
+static bool lane_next(RAMPLANE *lane, MYFLT sr) {
+  uint32_t h = atomic_load_explicit(&lane->head, memory_order_relaxed);
+  RAMPSEG *seg;
+  if(h == atomic_load_explicit(&lane->tail, memory_order_acquire))
+    return false;
+  seg = &lane->seg[h % RAMP_QSIZE];
+  lane->start = lane->value;
+  lane->target = seg->target;
+  lane->curve = seg->curve;
+  lane->len = (int64_t) (seg->dur*sr);
+  lane->pos = 0;
+  atomic_store_explicit(&lane->head, h + 1, memory_order_release);
+  return true;
+}
+
+/* renders a block; curves as in transeg (0 is linear). Until an
+   s7ramp instance has allocated the block, only the lane value
+   is advanced, so nothing is allocated here */
+static void lane_render(CSOUND *csound, RAMPLANE *lane) {
+  uint32_t n, nsmps = csound->GetKsmps(csound);
+  MYFLT sr = csound->GetSr(csound);
+  MYFLT *buf = lane->size == nsmps ? lane->buf : NULL;
+  for(n = 0; n < nsmps; n++) {
+    if(!lane->active) lane->active = lane_next(lane, sr);
+    while(lane->active && lane->pos >= lane->len) {
+      lane->value = lane->target;
+      lane->active = lane_next(lane, sr);
+    }
+    if(lane->active) {
+      double x = (double) lane->pos++/lane->len;
+      if(lane->curve != 0.0)
+        x = (1.0 - exp(x*lane->curve))/(1.0 - exp(lane->curve));
+      lane->value = lane->start + (lane->target - lane->start)*x;
+    }
+    if(buf != NULL) buf[n] = (MYFLT) lane->value;
+  }
+}
+
+static _Thread_local bool in_cmd_drain = false;
+
+static void cmd_run(S7CTX *ctx, S7CMD *cmd) {
+  switch(cmd->kind) {
+  case CMD_EVAL: {
+    s7_pointer form = read_code(ctx->s7, cmd->code);
+    s7_int loc = s7_gc_protect(ctx->s7, form);
+    cmd->result = s7_object_to_c_string(ctx->s7,
+                                        s7_eval(ctx->s7, form,
+                                                s7_rootlet(ctx->s7)));
+    defs_log(ctx->s7, form);
+    pool_replicate(ctx, form);
+    s7_gc_unprotect_at(ctx->s7, loc);
+    break;
+  }
+  case CMD_FORM:
+    cmd->value = s7_eval(ctx->s7, cmd->form, cmd->env);
+    cmd->loc = s7_gc_protect(ctx->s7, cmd->value);
+    defs_log(ctx->s7, cmd->form);
+    pool_replicate(ctx, cmd->form);
+    break;
+  case CMD_CALL:
+    cmd->call(cmd->arg);
+    break;
+#ifndef BUILDING_MODULE
+  case CMD_EVENTS: {
+    MYFLT *p = cmd->data, *end = cmd->data + cmd->size;
+    for(; p < end; p += (int64_t) *p + 1)
+      csoundEvent(ctx->csound, cmd->type, p + 1, (int64_t) *p, 0);
+    break;
+  }
+#endif
+  }
+}
+
+/* REPL commands and event batches come in separate queues, each
+   with a single producer and a single consumer */
+static void cmd_drain(S7CTX *ctx) {
+  S7CMD *cmd;
+  in_cmd_drain = true;
+  while((cmd = (S7CMD *) spsc_pop(&ctx->cmds)) != NULL) {
+    cmd_run(ctx, cmd);
+    while(!spsc_push(&ctx->done, cmd));
+  }
+  while((cmd = (S7CMD *) spsc_pop(&ctx->evts)) != NULL) {
+    cmd_run(ctx, cmd);
+    while(!spsc_push(&ctx->evdone, cmd));
+  }
+  in_cmd_drain = false;
+}
+
+static void kcycle(CSOUND *csound, void *userData) {
+  S7CTX *ctx = (S7CTX *) userData;
+  slot_ctx = ctx;
+  slot_idx = 0;
+  if(ctx->sched.len > 0 || !mpsc_empty(&ctx->sched.in)) sched_cycle(ctx);
+  if(atomic_load_explicit(&ctx->nlanes, memory_order_relaxed) > 0) {
+    int32_t i;
+    for(i = 0; i < RAMP_LANES; i++)
+      if(atomic_load_explicit(&ctx->lanes[i].state, memory_order_acquire)
+         == LANE_READY) lane_render(csound, &ctx->lanes[i]);
+  }
+  if(ctx->pool.cells > 0 && !pool_cycle(ctx)) return;
+  if(ctx->defs != NULL) defs_replicate(ctx);
+  if(!spsc_empty(&ctx->cmds) || !spsc_empty(&ctx->evts)) cmd_drain(ctx);
+  if(ctx->gc_mode == GC_KCYCLE) gc_schedule(ctx);
+}
+
+static int32_t ctx_reset(CSOUND *csound, void *userData) {
+  S7CTX *ctx = (S7CTX *) userData;
+  async_stop(csound, ctx);
+  pool_stop(csound, ctx);
+  ipool_free(csound, ctx);
+  prof_free(csound, ctx);
+  gc_hold(ctx, false, false);
+  ctx->gc_mode = GC_NORMAL;
+  ctx->pool.cells = 0;
+  return OK;
+}
+
+static int32_t ctx_create(CSOUND *csound) {
+  S7CTX *ctx;
+  if(get_ctx(csound) != NULL) return OK;
+  if(csound->CreateGlobalVariable(csound, "_S7CTX_", sizeof(S7CTX))
+     != CSOUND_SUCCESS) return NOTOK;
+  ctx = get_ctx(csound);
+  ctx->csound = csound;
+  ctx->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
+  ctx->sched.heap = (S7EVT **) csound->Calloc(csound,
+                                              SCHED_SIZE*sizeof(S7EVT *));
+  mpsc_init(&ctx->sched.in);
+  csound->RegisterSenseEventCallback(csound, kcycle, ctx);
+  csound->RegisterResetCallback(csound, ctx, ctx_reset);
+  return OK;
+}
+
+/* sets the initial heap size (in cells) and, with a
+   positive budget (in ms), the k-cycle GC mode, or with
+   a pool size (in cells), the real-time pool mode */
+static int32_t gc_setup(CSOUND *csound, s7_int heap_size, double budget,
+                        s7_int pool) {
+  S7CTX *ctx = get_ctx(csound);
+  s7_scheme *s7;
+  if(ctx == NULL) return NOTOK;
+  s7 = ctx->s7;
+  if(heap_size > 0) {
+    char code[64];
+    snprintf(code, 64, "(set! (*s7* 'heap-size) %lld)",
+             (long long) heap_size);
+    s7_eval_c_string(s7, code);
+  }
+  ctx->free_form = code_form(csound, s7, "(*s7* 'free-heap-size)");
+  ctx->gc_form = code_form(csound, s7, "(gc)");
+  if(pool > 0) {
+    if(ctx->pool.cells > 0) return OK;
+    ctx->pool.cells = pool;
+    pool_fill(ctx);
+    atomic_store(&ctx->pool.state, POOL_READY);
+    atomic_store(&ctx->pool.running, true);
+    ctx->pool.thread = csound->CreateThread(pool_thread, ctx);
+  }
+  else if(budget > 0) {
+    ctx->gc_low = s7_integer(s7_eval_c_string(s7, "(*s7* 'heap-size)"))/4;
+    ctx->heap_free = 0;
+    ctx->gc_budget = (uint64_t) (budget*1000000);
+    ctx->gc_mode = GC_KCYCLE;
+  }
+  return OK;
+}
+
 #ifndef BUILDING_MODULE
 
 static int32_t append_opcodes(CSOUND *csound, s7_scheme *s7); 
-static int cs_type_tag = 0;
+
+/******************************************************************************/
+/**
+ * interpreters and message passing
+ **/
+
+typedef struct {
+  MPSC_NODE node;
+  char *text;
+} S7MSG;
+
+/* registered interpreters, each with a mailbox; entries are
+   added and removed under the lock, and lookups by name are
+   lock-free: a removed entry is only freed once no lookup is
+   in progress */
+typedef struct s7interp {
+  _Atomic(struct s7interp *) next;
+  char name[64];
+  _Atomic(s7_scheme *) s7;  /* NULL once freed */
+  int32_t refs;             /* engines using it */
+  bool owned;               /* created (and freed) here */
+  int cs_tag, ch_tag;       /* c types made by cs_s7, or -1 */
+  MPSC box;
+} S7INTERP;
+
+static _Atomic(S7INTERP *) interps = NULL;
+static pthread_mutex_t interps_lock = PTHREAD_MUTEX_INITIALIZER;
+static int32_t interps_count = 0;
+static atomic_int interps_readers = 0;  /* lookups in progress */
+
+typedef struct cs_obj cs_obj;
+
+static S7INTERP *interp_find(const char *name) {
+  S7INTERP *e;
+  for(e = atomic_load(&interps); e != NULL; e = e->next)
+    if(atomic_load(&e->s7) != NULL && !strcmp(e->name, name)) return e;
+  return NULL;
+}
+
+static s7_pointer msg_send(s7_scheme *sc, s7_pointer args) {
+  S7INTERP *dest;
+  S7MSG *msg;
+  if(!s7_is_string(s7_car(args)))
+    return s7_wrong_type_arg_error(sc, "s7-send", 1, s7_car(args), "string");
+  msg = (S7MSG *) malloc(sizeof(S7MSG));
+  msg->text = s7_object_to_c_string(sc, s7_cadr(args));
+  atomic_fetch_add(&interps_readers, 1);
+  if((dest = interp_find(s7_string(s7_car(args)))) != NULL)
+    mpsc_push(&dest->box, &msg->node);
+  atomic_fetch_sub(&interps_readers, 1);
+  if(dest == NULL) {
+    free(msg->text);
+    free(msg);
+    return s7_error(sc, s7_make_symbol(sc, "no-such-interpreter"),
+                    s7_list(sc, 1, s7_car(args)));
+  }
+  return s7_t(sc);
+}
+
+static s7_pointer msg_receive(s7_scheme *sc, s7_pointer args) {
+  S7INTERP *self = (S7INTERP *)
+    s7_c_pointer(s7_name_to_value(sc, "*s7-mailbox*"));
+  S7MSG *msg = (S7MSG *) mpsc_pop(&self->box);
+  s7_pointer port, obj;
+  if(msg == NULL) return s7_eof_object(sc);
+  port = s7_open_input_string(sc, msg->text);
+  obj = s7_read(sc, port);
+  s7_close_input_port(sc, port);
+  free(msg->text);
+  free(msg);
+  return obj;
+}
+
+static s7_pointer interp_name(s7_scheme *sc, s7_pointer args) {
+  S7INTERP *self = (S7INTERP *)
+    s7_c_pointer(s7_name_to_value(sc, "*s7-mailbox*"));
+  return s7_make_string(sc, self->name);
+}
+
+/* registers an interpreter (called with the lock held) */
+static S7INTERP *interp_register(s7_scheme *s7, const char *name,
+                                 bool owned) {
+  S7INTERP *e = (S7INTERP *) calloc(1, sizeof(S7INTERP));
+  if(name != NULL && interp_find(name) == NULL)
+    snprintf(e->name, 64, "%s", name);
+  else snprintf(e->name, 64, "s7-%d", ++interps_count);
+  atomic_store(&e->s7, s7);
+  e->owned = owned;
+  e->cs_tag = e->ch_tag = -1;
+  mpsc_init(&e->box);
+  e->next = atomic_load(&interps);
+  atomic_store(&interps, e);
+  s7_define_constant(s7, "*s7-mailbox*", s7_make_c_pointer(s7, e));
+  s7_define_function(s7, "s7-send", msg_send, 2, 0, false,
+                     "(s7-send name obj) sends obj to the "
+                     "interpreter called name");
+  s7_define_function(s7, "s7-receive", msg_receive, 0, 0, false,
+                     "(s7-receive) returns the next message sent to "
+                     "this interpreter, or #<eof> if there is none");
+  s7_define_function(s7, "s7-interp-name", interp_name, 0, 0, false,
+                     "(s7-interp-name) returns the name of "
+                     "this interpreter");
+  return e;
+}
+
+/* the entry of an interpreter, which it holds as its mailbox */
+static inline S7INTERP *interp_of(s7_scheme *s7) {
+  s7_pointer box = s7_name_to_value(s7, "*s7-mailbox*");
+  return s7_is_c_pointer(box) ? (S7INTERP *) s7_c_pointer(box) : NULL;
+}
+
+/* c type tags are per interpreter, as each one numbers its own */
+static inline int cs_type_tag(s7_scheme *sc) {
+  S7INTERP *e = interp_of(sc);
+  return e != NULL ? e->cs_tag : -1;
+}
+
+static inline int ch_type_tag(s7_scheme *sc) {
+  S7INTERP *e = interp_of(sc);
+  return e != NULL ? e->ch_tag : -1;
+}
+
+/* gets a new interpreter or, if named, an existing one */
+static S7INTERP *interp_acquire(const char *name) {
+  S7INTERP *e;
+  pthread_mutex_lock(&interps_lock);
+  if(name == NULL || (e = interp_find(name)) == NULL || !e->owned)
+    e = interp_register(s7_init(), name, true);
+  e->refs++;
+  pthread_mutex_unlock(&interps_lock);
+  return e;
+}
+
+/* the last release of an interpreter created here frees it
+   and removes its entry */
+static void interp_release(S7INTERP *e) {
+  struct timespec ts = { 0, 100000 };
+  _Atomic(S7INTERP *) *link;
+  s7_scheme *s7;
+  S7MSG *msg;
+  pthread_mutex_lock(&interps_lock);
+  if(--e->refs > 0 || !e->owned) {
+    pthread_mutex_unlock(&interps_lock);
+    return;
+  }
+  s7 = atomic_load(&e->s7);
+  atomic_store(&e->s7, NULL);
+  for(link = &interps; atomic_load(link) != e; link = &atomic_load(link)->next);
+  atomic_store(link, atomic_load(&e->next));
+  pthread_mutex_unlock(&interps_lock);
+  /* lookups that reached the entry may still push messages to it */
+  while(atomic_load(&interps_readers) > 0) nanosleep(&ts, NULL);
+  while((msg = (S7MSG *) mpsc_pop(&e->box)) != NULL) {
+    free(msg->text);
+    free(msg);
+  }
+  free(e);
+  s7_free(s7);
+}
+
+/* Csound messages, captured without blocking into a bounded
+   multi-producer ring (the callback may run on any engine thread) */
+#define MSG_LEN 256
+#define MSG_SLOTS 1024
+
+typedef struct {
+  atomic_size_t seq;
+  int32_t attr;
+  double time;
+  char text[MSG_LEN];
+} MSGSLOT;
+
 typedef struct {
+  MSGSLOT *slots;
+  size_t mask;
+  atomic_size_t head, tail;
+  atomic_uint_fast64_t dropped;
+  uint64_t t0;
+} MSGRING;
+
+static void msgring_init(MSGRING *r, size_t size) {
+  size_t n = 1, i;
+  while(n < size) n <<= 1;
+  r->slots = (MSGSLOT *) calloc(n, sizeof(MSGSLOT));
+  for(i = 0; i < n; i++) atomic_init(&r->slots[i].seq, i);
+  r->mask = n - 1;
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  atomic_init(&r->dropped, 0);
+  r->t0 = now_ns();
+}
+
+static void msgring_push(MSGRING *r, int32_t attr, const char *fmt,
+                         va_list args) {
+  size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+  MSGSLOT *slot;
+  for(;;) {
+    intptr_t diff;
+    slot = &r->slots[pos & r->mask];
+    diff = (intptr_t) atomic_load_explicit(&slot->seq, memory_order_acquire)
+      - (intptr_t) pos;
+    if(diff == 0) {
+      if(atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                               memory_order_relaxed,
+                                               memory_order_relaxed))
+        break;
+    } else if(diff < 0) { /* full */
+      atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+      return;
+    } else pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+  }
+  slot->attr = attr;
+  slot->time = (now_ns() - r->t0)*1e-9;
+  vsnprintf(slot->text, MSG_LEN, fmt, args);
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+/* single consumer */
+static MSGSLOT *msgring_peek(MSGRING *r) {
+  size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  MSGSLOT *slot = &r->slots[pos & r->mask];
+  if(atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+    return NULL;
+  return slot;
+}
+
+static void msgring_next(MSGRING *r) {
+  size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  atomic_store_explicit(&r->slots[pos & r->mask].seq, pos + r->mask + 1,
+                        memory_order_release);
+  atomic_store_explicit(&r->tail, pos + 1, memory_order_relaxed);
+}
+
+struct cs_obj {
   CSOUND *csound;
   CS_PERF_THREAD *perf;  
   bool pause; // perf pause flag
-} cs_obj;
+  s7_int heap_size; // initial s7 heap size
+  double gc_budget; // GC time budget per k-cycle (ms)
+  s7_int rt_pool; // real-time pool size
+  s7_scheme *s7; // engine interpreter
+  S7INTERP *interp; // if not using the creating interpreter
+  uint64_t epoch; // engine resets
+  s7_pointer views[2]; // spin/spout float-vectors
+  uint64_t view_epoch;
+  s7_pointer rendered; // csound-render output being collected
+  S7EVT *sched_head, *sched_tail; // scheduled events, in submission order
+  int32_t sched_pending; // not yet freed
+  MSGRING *msgs; // captured messages, if any
+  _Atomic(s7_pointer) proc_frame; // process callback (proc #(block secs))
+  s7_int proc_loc, proc_every;
+  s7_pointer proc_running; // frame being called
+  s7_int proc_stale; // loc of a frame replaced while it was running
+  bool stale;
+  uint64_t proc_blocks;
+  bool pooled; // from the engine pool
+  bool cleared; // released pooled engine, reset but not set up
+  S7INTERP *home; // own interpreter of a pooled engine bound to another
+  cs_obj *pool_next;
+};
 
-static inline bool cs_check(s7_pointer obj){
-  cs_obj *cs = (cs_obj *) s7_c_object_value(obj);
+/* engines returned to the pool leave their objects empty */
+static inline bool cs_check(s7_scheme *sc, s7_pointer obj){
   return (s7_is_c_object(obj) &&
-          s7_c_object_type(obj) == cs_type_tag);
+          s7_c_object_type(obj) == cs_type_tag(sc) &&
+          ((cs_obj *) s7_c_object_value(obj))->csound != NULL);
 }
 
 static inline s7_pointer cs_type_err(s7_scheme *sc, s7_pointer args,
@@ -48,16 +1326,54 @@ static inline s7_pointer cs_type_err(s7_scheme *sc, s7_pointer args,
   return s7_wrong_type_arg_error(sc, caller, 0, s7_car(args), "csound-obj");
 }
   
+static void msg_callback(CSOUND *csound, int32_t attr, const char *fmt,
+                         va_list args) {
+  cs_obj *cs = (cs_obj *) csoundGetHostData(csound);
+  msgring_push(cs->msgs, attr, fmt, args);
+}
+
+/* engine setup, on creation and after reset */
+static int32_t engine_setup(cs_obj *cs) {
+  int32_t res;
+  if(cs->msgs != NULL) csoundSetMessageCallback(cs->csound, msg_callback);
+  if((res = append_opcodes(cs->csound, cs->s7)) == CSOUND_SUCCESS) {
+    csoundSetOption(cs->csound, "-odac");
+    res = gc_setup(cs->csound, cs->heap_size, cs->gc_budget, cs->rt_pool);
+  }
+  return res;
+}
+
+/* make-csound options; an engine that already has an interpreter
+   of its own keeps it */
+static void engine_opts(s7_scheme *sc, cs_obj *cs, s7_pointer args) {
+  s7_pointer heap = s7_car(args), budget = s7_cadr(args);
+  s7_pointer pool = s7_caddr(args), interp = s7_cadddr(args);
+  s7_pointer msgs = s7_list_ref(sc, args, 4);
+  if(s7_is_integer(heap)) cs->heap_size = s7_integer(heap);
+  if(s7_is_real(budget)) cs->gc_budget = s7_real(budget);
+  if(s7_is_integer(pool)) cs->rt_pool = s7_integer(pool);
+  if(cs->interp == NULL) {
+    if(s7_is_string(interp)) cs->interp = interp_acquire(s7_string(interp));
+    else if(interp == s7_t(sc)) cs->interp = interp_acquire(NULL);
+  }
+  cs->s7 = cs->interp ? atomic_load(&cs->interp->s7) : sc;
+  if(cs->msgs == NULL &&
+     ((s7_is_integer(msgs) && s7_integer(msgs) > 0) || msgs == s7_t(sc))) {
+    cs->msgs = (MSGRING *) malloc(sizeof(MSGRING));
+    msgring_init(cs->msgs, s7_is_integer(msgs) ? s7_integer(msgs) : MSG_SLOTS);
+  }
+}
+
 static s7_pointer create(s7_scheme *sc, s7_pointer args) {
   int32_t res;
   cs_obj *cs = (cs_obj *) calloc(1, sizeof(cs_obj));
+  engine_opts(sc, cs, args);
   cs->csound = csoundCreate(cs, NULL);
   if(cs->csound != NULL) {
-    if((res = append_opcodes(cs->csound, sc)) == CSOUND_SUCCESS) {
-      csoundSetOption(cs->csound, "-odac");
+    if((res = engine_setup(cs)) == CSOUND_SUCCESS) {
       cs->perf = NULL;
       cs->pause = false;
-      return s7_make_c_object(sc, cs_type_tag, (void *) cs);
+      return s7_make_c_object(sc, cs_type_tag(sc), (void *) cs);
     }
   } else res = -1;
   return s7_error(sc, s7_make_symbol(sc, "failed-csound-create"),
@@ -65,7 +1381,7 @@ static s7_pointer create(s7_scheme *sc, s7_pointer args) {
 }
 
 static s7_pointer compile(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
     int32_t async = cs->perf ? 1 : 0;
     if(!s7_is_string(s7_cadr(args)))
@@ -78,7 +1394,7 @@ static s7_pointer compile(s7_scheme *sc, s7_pointer args) {
 }
 
 static s7_pointer options(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
     if(!s7_is_string(s7_cadr(args)))
       return s7_wrong_type_arg_error(sc,"csound-options",1,s7_car(args),
@@ -89,7 +1405,7 @@ static s7_pointer options(s7_scheme *sc, s7_pointer args) {
 }
 
 static s7_pointer event_string(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
     int32_t async = cs->perf ? 1 : 0;
     if(!s7_is_string(s7_cadr(args)))
@@ -101,25 +1417,163 @@ static s7_pointer event_string(s7_scheme *sc, s7_pointer args) {
 }
 
 static s7_pointer event(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
     int32_t async = cs->perf ? 1 : 0;
-    s7_pointer s7p, argp;
+    s7_pointer argp;
     int32_t type = s7_integer(s7_cadr(args));
-    MYFLT p[16] = {0};
-    int32_t n = 0;
-    argp = s7_cdr(s7_cdr(args));
-    while((s7p = s7_car(argp))) {
-      p[n++] = (MYFLT) s7_real(s7p);
-      argp = s7_cdr(argp);
-    }
-    csoundEvent(cs->csound, type, p, n-1, async);
+    MYFLT buf[16], *p = buf;
+    int64_t n = 0, size = s7_list_length(sc, s7_cddr(args));
+    if(size > 16) p = (MYFLT *) malloc(size*sizeof(MYFLT));
+    for(argp = s7_cddr(args); s7_is_pair(argp); argp = s7_cdr(argp))
+      p[n++] = (MYFLT) s7_number_to_real(sc, s7_car(argp));
+    csoundEvent(cs->csound, type, p, n, async);
+    if(p != buf) free(p);
     return s7_cdr(args);
   } else return cs_type_err(sc, args,"csound-event");
 }
 
+static bool engine_running(cs_obj *cs);
+
+/* events are packed into a single command, inserted by the
+   performance thread at the next k-cycle boundary */
+static s7_pointer events(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
+    S7CTX *ctx = get_ctx(cs->csound);
+    s7_pointer evts = s7_caddr(args), e, f;
+    int32_t type = s7_integer(s7_cadr(args));
+    int64_t size = 0, nevts = 0, rows, cols, i, j;
+    S7CMD *cmd;
+    MYFLT *p;
+    if(s7_is_float_vector(evts) && s7_vector_rank(evts) == 2) {
+      s7_double *v = s7_float_vector_elements(evts);
+      rows = s7_vector_dimension(evts, 0);
+      cols = s7_vector_dimension(evts, 1);
+      size = rows*(cols + 1);
+      cmd = (S7CMD *) malloc(sizeof(S7CMD) + size*sizeof(MYFLT));
+      for(i = 0, p = cmd->data; i < rows; i++) {
+        *p++ = (MYFLT) cols;
+        for(j = 0; j < cols; j++) *p++ = (MYFLT) v[i*cols + j];
+      }
+      nevts = rows;
+    }
+    else if(s7_is_list(sc, evts)) {
+      for(e = evts; s7_is_pair(e); e = s7_cdr(e)) {
+        if(!s7_is_list(sc, s7_car(e)))
+          return s7_wrong_type_arg_error(sc, "csound-events", 2, evts,
+                                         "a list of lists");
+        for(f = s7_car(e); s7_is_pair(f); f = s7_cdr(f))
+          if(!s7_is_real(s7_car(f)))
+            return s7_wrong_type_arg_error(sc, "csound-events", 2, evts,
+                                           "a list of lists of numbers");
+        size += s7_list_length(sc, s7_car(e)) + 1;
+      }
+      cmd = (S7CMD *) malloc(sizeof(S7CMD) + size*sizeof(MYFLT));
+      for(e = evts, p = cmd->data; s7_is_pair(e); e = s7_cdr(e), nevts++) {
+        *p++ = (MYFLT) s7_list_length(sc, s7_car(e));
+        for(f = s7_car(e); s7_is_pair(f); f = s7_cdr(f))
+          *p++ = (MYFLT) s7_number_to_real(sc, s7_car(f));
+      }
+    }
+    else return s7_wrong_type_arg_error(sc, "csound-events", 2, evts,
+                                        "a list of lists or a 2D "
+                                        "float-vector");
+    cmd->kind = CMD_EVENTS;
+    cmd->type = type;
+    cmd->size = size;
+    /* finished batches are freed here, by their producer */
+    while((e = (s7_pointer) spsc_pop(&ctx->evdone)) != NULL) free(e);
+    if(!in_cmd_drain && engine_running(cs) && spsc_push(&ctx->evts, cmd))
+      return s7_make_integer(sc, nevts);
+    /* not running (or the queue is full): events are sent directly */
+    for(p = cmd->data; p < cmd->data + size; p += (int64_t) *p + 1)
+      csoundEvent(cs->csound, type, p + 1, (int64_t) *p,
+                  cs->perf != NULL && !in_cmd_drain ? 1 : 0);
+    free(cmd);
+    return s7_make_integer(sc, nevts);
+  } else return cs_type_err(sc, args,"csound-events");
+}
+
+/* frees dispatched events anywhere in the list (so that one
+   far in the future does not hold back those after it) or,
+   after a reset, all of them */
+static void sched_reclaim(cs_obj *cs, bool all) {
+  S7EVT *e, *prev = NULL, *next;
+  for(e = cs->sched_head; e != NULL; e = next) {
+    next = e->next;
+    if(all || atomic_load_explicit(&e->done, memory_order_acquire)) {
+      if(prev != NULL) prev->next = next;
+      else cs->sched_head = next;
+      cs->sched_pending--;
+      free(e);
+    }
+    else prev = e;
+  }
+  cs->sched_tail = prev;
+}
+
+static s7_pointer event_at(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
+    S7CTX *ctx = get_ctx(cs->csound);
+    s7_pointer argp;
+    int64_t n = s7_list_length(sc, s7_cdddr(args));
+    S7EVT *e;
+    if(!s7_is_real(s7_cadr(args)))
+      return s7_wrong_type_arg_error(sc, "csound-event-at", 2, s7_cadr(args),
+                                     "a real");
+    if(!s7_is_integer(s7_caddr(args)))
+      return s7_wrong_type_arg_error(sc, "csound-event-at", 3,
+                                     s7_caddr(args), "an integer");
+    for(argp = s7_cdddr(args); s7_is_pair(argp); argp = s7_cdr(argp))
+      if(!s7_is_real(s7_car(argp)))
+        return s7_wrong_type_arg_error(sc, "csound-event-at", 4,
+                                       s7_car(argp), "a real");
+    sched_reclaim(cs, false);
+    if(cs->sched_pending >= SCHED_SIZE)
+      return s7_error(sc, s7_make_symbol(sc, "csound-scheduler-full"),
+                      s7_list(sc, 1, s7_cadr(args)));
+    e = (S7EVT *) malloc(sizeof(S7EVT) + n*sizeof(MYFLT));
+    e->next = NULL;
+    atomic_store(&e->done, false);
+    e->frame = (int64_t) s7_number_to_real(sc, s7_cadr(args));
+    e->type = (int32_t) s7_integer(s7_caddr(args));
+    e->n = 0;
+    for(argp = s7_cdddr(args); s7_is_pair(argp); argp = s7_cdr(argp))
+      e->p[e->n++] = (MYFLT) s7_number_to_real(sc, s7_car(argp));
+    mpsc_push(&ctx->sched.in, &e->node);
+    cs->sched_pending++;
+    if(cs->sched_tail != NULL) cs->sched_tail->next = e;
+    else cs->sched_head = e;
+    cs->sched_tail = e;
+    return s7_cadr(args);
+  } else return cs_type_err(sc, args,"csound-event-at");
+}
+
+static s7_pointer ramp(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
+    RAMPLANE *lane;
+    if(!s7_is_string(s7_cadr(args)))
+      return s7_wrong_type_arg_error(sc, "csound-ramp", 2, s7_cadr(args),
+                                     "string");
+    if(strlen(s7_string(s7_cadr(args))) >= RAMP_NAME)
+      return s7_out_of_range_error(sc, "csound-ramp", 2, s7_cadr(args),
+                                   "a name of up to 63 characters");
+    lane = lane_find(get_ctx(cs->csound), s7_string(s7_cadr(args)), true);
+    if(lane == NULL || !lane_push(lane, s7_number_to_real(sc, s7_caddr(args)),
+                                  s7_number_to_real(sc, s7_cadddr(args)),
+                                  s7_number_to_real(sc, s7_list_ref(sc, args,
+                                                                    4))))
+      return s7_error(sc, s7_make_symbol(sc, "csound-ramp-full"),
+                      s7_list(sc, 1, s7_cadr(args)));
+    return s7_caddr(args);
+  } else return cs_type_err(sc, args,"csound-ramp");
+}
+
 static s7_pointer compile_string(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
     int32_t async = cs->perf ? 1 : 0;
     if(!s7_is_string(s7_cadr(args)))
@@ -131,7 +1585,7 @@ static s7_pointer compile_string(s7_scheme *sc, s7_pointer args) {
 }
 
 static s7_pointer get_channel(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
     if(!s7_is_string(s7_cadr(args)))
       return s7_wrong_type_arg_error(sc,"csound-get-channel",1,s7_car(args),
@@ -143,7 +1597,7 @@ static s7_pointer get_channel(s7_scheme *sc, s7_pointer args) {
 }
 
 static s7_pointer set_channel(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
     s7_pointer pval = s7_cadr(s7_cdr(args));
     MYFLT val;
@@ -157,18 +1611,402 @@ static s7_pointer set_channel(s7_scheme *sc, s7_pointer args) {
   } else return cs_type_err(sc, args,"csound-set-channel");
 }
 
+/* channel handles: control channel pointers, so that get and
+   set do not look up the channel by name. The pointers are
+   fetched again if the engine has been reset since. */
+typedef struct {
+  s7_pointer csobj;
+  uint64_t epoch;
+  int32_t n;
+  char **names;
+  MYFLT **ptrs;
+} ch_obj;
+
+static bool ch_resolve(ch_obj *ch) {
+  cs_obj *cs = (cs_obj *) s7_c_object_value(ch->csobj);
+  int32_t i;
+  if(cs->csound == NULL) return false;
+  for(i = 0; i < ch->n; i++)
+    if(csoundGetChannelPtr(cs->csound, (void **) &ch->ptrs[i], ch->names[i],
+                           CSOUND_CONTROL_CHANNEL | CSOUND_INPUT_CHANNEL |
+                           CSOUND_OUTPUT_CHANNEL) != CSOUND_SUCCESS)
+      return false;
+  ch->epoch = cs->epoch;
+  return true;
+}
+
+static inline bool ch_ready(ch_obj *ch) {
+  cs_obj *cs = (cs_obj *) s7_c_object_value(ch->csobj);
+  return LIKELY(cs->csound != NULL && ch->epoch == cs->epoch) ||
+    ch_resolve(ch);
+}
+
+static inline MYFLT ch_load(MYFLT *p) {
+  MYFLT val;
+  __atomic_load(p, &val, __ATOMIC_ACQUIRE);
+  return val;
+}
+
+static inline void ch_store(MYFLT *p, MYFLT val) {
+  __atomic_store(p, &val, __ATOMIC_RELEASE);
+}
+
+static inline bool ch_check(s7_scheme *sc, s7_pointer obj) {
+  return s7_is_c_object(obj) && s7_c_object_type(obj) == ch_type_tag(sc);
+}
+
+static void ch_free(ch_obj *ch) {
+  int32_t i;
+  for(i = 0; i < ch->n; i++) free(ch->names[i]);
+  free(ch->names);
+  free(ch->ptrs);
+  free(ch);
+}
+
+static s7_pointer free_chobj(s7_scheme *sc, s7_pointer obj) {
+  ch_free((ch_obj *) s7_c_object_value(obj));
+  return NULL;
+}
+
+/* handles keep their engine alive */
+static s7_pointer mark_chobj(s7_scheme *sc, s7_pointer obj) {
+  s7_mark(((ch_obj *) s7_c_object_value(obj))->csobj);
+  return NULL;
+}
+
+static s7_pointer channel(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    s7_pointer names = s7_cadr(args), p;
+    ch_obj *ch;
+    int32_t i;
+    if(s7_is_string(names)) names = s7_list(sc, 1, names);
+    for(p = names; s7_is_pair(p); p = s7_cdr(p))
+      if(!s7_is_string(s7_car(p))) break;
+    if(!s7_is_pair(names) || !s7_is_null(sc, p))
+      return s7_wrong_type_arg_error(sc, "csound-channel", 2, s7_cadr(args),
+                                     "a string or a list of strings");
+    ch = (ch_obj *) calloc(1, sizeof(ch_obj));
+    ch->csobj = s7_car(args);
+    ch->n = (int32_t) s7_list_length(sc, names);
+    ch->names = (char **) calloc(ch->n, sizeof(char *));
+    ch->ptrs = (MYFLT **) calloc(ch->n, sizeof(MYFLT *));
+    for(i = 0, p = names; i < ch->n; i++, p = s7_cdr(p))
+      ch->names[i] = strdup(s7_string(s7_car(p)));
+    if(!ch_resolve(ch)) {
+      ch_free(ch);
+      return s7_error(sc, s7_make_symbol(sc, "csound-channel-error"),
+                      s7_list(sc, 1, s7_cadr(args)));
+    }
+    return s7_make_c_object(sc, ch_type_tag(sc), (void *) ch);
+  } else return cs_type_err(sc, args,"csound-channel");
+}
+
+static s7_pointer channel_ref(s7_scheme *sc, s7_pointer args) {
+  if(ch_check(sc, s7_car(args))) {
+    ch_obj *ch = (ch_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer vec = s7_is_pair(s7_cdr(args)) ? s7_cadr(args) : s7_f(sc);
+    s7_double *v;
+    int32_t i;
+    if(!ch_ready(ch)) return s7_f(sc);
+    if(ch->n == 1 && vec == s7_f(sc))
+      return s7_make_real(sc, ch_load(ch->ptrs[0]));
+    if(!s7_is_float_vector(vec) || s7_vector_length(vec) < ch->n)
+      vec = s7_make_float_vector(sc, ch->n, 1, NULL);
+    v = s7_float_vector_elements(vec);
+    for(i = 0; i < ch->n; i++) v[i] = ch_load(ch->ptrs[i]);
+    return vec;
+  } else return s7_wrong_type_arg_error(sc, "csound-channel-ref", 1,
+                                        s7_car(args), "a channel handle");
+}
+
+static s7_pointer channel_set(s7_scheme *sc, s7_pointer args) {
+  if(ch_check(sc, s7_car(args))) {
+    ch_obj *ch = (ch_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer val = s7_cadr(args);
+    int32_t i;
+    if(!ch_ready(ch)) return s7_f(sc);
+    if(s7_is_float_vector(val)) {
+      s7_double *v = s7_float_vector_elements(val);
+      int32_t n = s7_vector_length(val) < ch->n ?
+        (int32_t) s7_vector_length(val) : ch->n;
+      for(i = 0; i < n; i++) ch_store(ch->ptrs[i], (MYFLT) v[i]);
+    }
+    else if(s7_is_pair(val)) {
+      for(i = 0; i < ch->n && s7_is_pair(val); i++, val = s7_cdr(val))
+        ch_store(ch->ptrs[i], (MYFLT) s7_number_to_real(sc, s7_car(val)));
+      val = s7_cadr(args);
+    }
+    else ch_store(ch->ptrs[0],
+                  (MYFLT) s7_number_to_real_with_caller(sc, val,
+                                                        "csound-channel-set!"));
+    return val;
+  } else return s7_wrong_type_arg_error(sc, "csound-channel-set!", 1,
+                                        s7_car(args), "a channel handle");
+}
+
+static s7_pointer table_err(s7_scheme *sc, s7_pointer args) {
+  return s7_error(sc, s7_make_symbol(sc, "no-such-table"),
+                  s7_list(sc, 1, s7_cadr(args)));
+}
+
+static s7_pointer table_num_err(s7_scheme *sc, s7_pointer args,
+                                const char *caller) {
+  return s7_wrong_type_arg_error(sc, caller, 2, s7_cadr(args),
+                                 "an integer");
+}
+
+/* the optional start position, from 0 to the table length;
+   returns an error, or NULL if it is valid */
+static s7_pointer table_start(s7_scheme *sc, s7_pointer args,
+                              const char *caller, int32_t len,
+                              s7_int *start) {
+  s7_pointer arg;
+  *start = 0;
+  if(!s7_is_pair(s7_cdddr(args))) return NULL;
+  arg = s7_cadddr(args);
+  if(!s7_is_integer(arg))
+    return s7_wrong_type_arg_error(sc, caller, 4, arg, "an integer");
+  *start = s7_integer(arg);
+  if(*start < 0 || *start > len)
+    return s7_out_of_range_error(sc, caller, 4, arg,
+                                 "a position within the table");
+  return NULL;
+}
+
+/* the float-vector holds a copy of the table, as a wrapper
+   would not outlive the engine or the table */
+static s7_pointer table(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer vec;
+    MYFLT *data;
+    int32_t len;
+    if(!s7_is_integer(s7_cadr(args)))
+      return table_num_err(sc, args, "csound-table");
+    len = csoundGetTable(cs->csound, &data,
+                         (int32_t) s7_integer(s7_cadr(args)));
+    if(len < 0) return table_err(sc, args);
+    vec = s7_make_float_vector(sc, len, 1, NULL);
+    copy_from_myflt(s7_float_vector_elements(vec), data, len);
+    return vec;
+  } else return cs_type_err(sc, args,"csound-table");
+}
+
+static s7_pointer table_copy_in(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer vec = s7_caddr(args), err;
+    s7_int start, n;
+    MYFLT *data;
+    int32_t len;
+    if(!s7_is_integer(s7_cadr(args)))
+      return table_num_err(sc, args, "csound-table-copy-in");
+    len = csoundGetTable(cs->csound, &data,
+                         (int32_t) s7_integer(s7_cadr(args)));
+    if(len < 0) return table_err(sc, args);
+    if(!s7_is_float_vector(vec))
+      return s7_wrong_type_arg_error(sc, "csound-table-copy-in", 3, vec,
+                                     "a float-vector");
+    if((err = table_start(sc, args, "csound-table-copy-in", len,
+                           &start)) != NULL)
+      return err;
+    n = s7_vector_length(vec);
+    if(n > len - start) n = len - start;
+    copy_to_myflt(data + start, s7_float_vector_elements(vec), n);
+    return s7_make_integer(sc, n);
+  } else return cs_type_err(sc, args,"csound-table-copy-in");
+}
+
+static s7_pointer table_copy_out(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer vec = s7_is_pair(s7_cddr(args)) ? s7_caddr(args) : s7_f(sc);
+    s7_pointer err;
+    s7_int start, n;
+    MYFLT *data;
+    int32_t len;
+    if(!s7_is_integer(s7_cadr(args)))
+      return table_num_err(sc, args, "csound-table-copy-out");
+    len = csoundGetTable(cs->csound, &data,
+                         (int32_t) s7_integer(s7_cadr(args)));
+    if(len < 0) return table_err(sc, args);
+    if((err = table_start(sc, args, "csound-table-copy-out", len,
+                           &start)) != NULL)
+      return err;
+    if(!s7_is_float_vector(vec))
+      vec = s7_make_float_vector(sc, len - start, 1, NULL);
+    n = s7_vector_length(vec);
+    if(n > len - start) n = len - start;
+    copy_from_myflt(s7_float_vector_elements(vec), data + start, n);
+    return vec;
+  } else return cs_type_err(sc, args,"csound-table-copy-out");
+}
+
+/* spin/spout views, made once per engine start and copied in
+   and out by csound-perform-ksmps; they are s7 vectors of their
+   own, so they stay valid if the engine is reset or collected */
+enum { VIEW_SPIN = 0, VIEW_SPOUT };
+
+static s7_pointer audio_view(s7_scheme *sc, cs_obj *cs, int32_t which) {
+  s7_int len;
+  MYFLT *buf;
+  if(cs->view_epoch != cs->epoch + 1) {
+    cs->views[VIEW_SPIN] = cs->views[VIEW_SPOUT] = NULL;
+    cs->view_epoch = cs->epoch + 1;
+  }
+  if(cs->views[which] != NULL) return cs->views[which];
+  if(which == VIEW_SPIN) {
+    buf = csoundGetSpin(cs->csound);
+    len = csoundGetKsmps(cs->csound)*csoundGetNchnlsInput(cs->csound);
+  } else {
+    buf = (MYFLT *) csoundGetSpout(cs->csound);
+    len = csoundGetKsmps(cs->csound)*csoundGetNchnls(cs->csound);
+  }
+  if(buf == NULL) return s7_f(sc);
+  cs->views[which] = s7_make_float_vector(sc, len, 1, NULL);
+  copy_from_myflt(s7_float_vector_elements(cs->views[which]), buf, len);
+  return cs->views[which];
+}
+
+static s7_pointer spin(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args)))
+    return audio_view(sc, (cs_obj *) s7_c_object_value(s7_car(args)),
+                      VIEW_SPIN);
+  else return cs_type_err(sc, args,"csound-spin");
+}
+
+static s7_pointer spout(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args)))
+    return audio_view(sc, (cs_obj *) s7_c_object_value(s7_car(args)),
+                      VIEW_SPOUT);
+  else return cs_type_err(sc, args,"csound-spout");
+}
+
+/* one block of synchronous performance */
+static int32_t perform_block(cs_obj *cs) {
+  S7CTX *ctx = get_ctx(cs->csound);
+  int32_t res;
+  bool views = cs->view_epoch == cs->epoch + 1;
+  if(views && cs->views[VIEW_SPIN] != NULL)
+    copy_to_myflt(csoundGetSpin(cs->csound),
+                  s7_float_vector_elements(cs->views[VIEW_SPIN]),
+                  s7_vector_length(cs->views[VIEW_SPIN]));
+  gc_perf(ctx, true, false);
+  res = csoundPerformKsmps(cs->csound);
+  gc_perf(ctx, false, false);
+  if(views && cs->views[VIEW_SPOUT] != NULL)
+    copy_from_myflt(s7_float_vector_elements(cs->views[VIEW_SPOUT]),
+                    csoundGetSpout(cs->csound),
+                    s7_vector_length(cs->views[VIEW_SPOUT]));
+  return res;
+}
+
 static s7_pointer perf_ksmps(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     int32_t res = -1; 
     cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
-    if(cs->perf == NULL) res = csoundPerformKsmps(cs->csound);
+    if(cs->perf == NULL) res = perform_block(cs);
     return s7_make_integer(sc, res);
   } else return cs_type_err(sc, args,"csound-ksmps");
 }
 
+/* offline rendering loop, for synchronous performance: runs
+   for a number of seconds or frames, or until the end of the
+   score, calling a hook every so many blocks (stopping if it
+   returns #f) and optionally collecting the output straight
+   into a float-vector, grown by doubling if the length is not
+   known and trimmed (sharing its elements) at the end */
+static s7_pointer render(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer secs = s7_cadr(args), frames = s7_caddr(args);
+    s7_pointer hook = s7_list_ref(sc, args, 4);
+    s7_pointer every_arg = s7_list_ref(sc, args, 5);
+    bool until_end = s7_boolean(sc, s7_cadddr(args));
+    bool collect = s7_boolean(sc, s7_list_ref(sc, args, 6));
+    int64_t ksmps = csoundGetKsmps(cs->csound), blocks = -1, n = 0;
+    int64_t len = ksmps*csoundGetNchnls(cs->csound), size = 0, cap = 0;
+    s7_double *out = NULL;
+    s7_pointer res = s7_f(sc), prev = cs->rendered;
+    s7_int every;
+    bool ended = false;
+    if(frames != s7_f(sc) && !s7_is_real(frames))
+      return s7_wrong_type_arg_error(sc, "csound-render", 3, frames,
+                                     "a real or #f");
+    if(secs != s7_f(sc) && !s7_is_real(secs))
+      return s7_wrong_type_arg_error(sc, "csound-render", 2, secs,
+                                     "a real or #f");
+    if(hook != s7_f(sc) && !s7_is_procedure(hook))
+      return s7_wrong_type_arg_error(sc, "csound-render", 5, hook,
+                                     "a procedure or #f");
+    if(!s7_is_integer(every_arg))
+      return s7_wrong_type_arg_error(sc, "csound-render", 6, every_arg,
+                                     "an integer");
+    if((every = s7_integer(every_arg)) < 1)
+      return s7_out_of_range_error(sc, "csound-render", 6, every_arg,
+                                   "a positive integer");
+    if(s7_is_real(frames) && s7_number_to_real(sc, frames) < 0)
+      return s7_out_of_range_error(sc, "csound-render", 3, frames,
+                                   "a non-negative size");
+    if(s7_is_real(secs) && s7_number_to_real(sc, secs) < 0)
+      return s7_out_of_range_error(sc, "csound-render", 2, secs,
+                                   "a non-negative duration");
+    if(cs->perf != NULL) return s7_make_integer(sc, -1);
+    if(s7_is_real(frames))
+      blocks = ((int64_t) s7_number_to_real(sc, frames) + ksmps - 1)/ksmps;
+    else if(s7_is_real(secs))
+      blocks = ((int64_t) (s7_number_to_real(sc, secs)*
+                           csoundGetSr(cs->csound)) + ksmps - 1)/ksmps;
+    else if(!until_end) return s7_make_integer(sc, 0);
+    /* the output is kept by the engine object, so nothing is left
+       protected if the hook raises an error */
+    if(collect) {
+      cap = blocks > 0 ? blocks*len : 1024*len;
+      cs->rendered = res = s7_make_float_vector(sc, cap, 1, NULL);
+      out = s7_float_vector_elements(res);
+    }
+    while(blocks < 0 || n < blocks) {
+      int32_t end = perform_block(cs);
+      if((ended = end != 0)) break;  /* score ended (or error) */
+      n++;
+      if(collect) {
+        if(size + len > cap) {
+          s7_pointer vec = s7_make_float_vector(sc, 2*cap, 1, NULL);
+          memcpy(s7_float_vector_elements(vec), out, size*sizeof(s7_double));
+          cs->rendered = res = vec;
+          out = s7_float_vector_elements(vec);
+          cap *= 2;
+        }
+        copy_from_myflt(out + size, csoundGetSpout(cs->csound), len);
+        size += len;
+      }
+      if(hook != s7_f(sc) && n % every == 0 &&
+         s7_call(sc, hook, s7_list(sc, 2, s7_car(args),
+                                   s7_make_integer(sc, n*ksmps))) == s7_f(sc))
+        break;
+    }
+    /* a duration rendered in full is padded with silence if the
+       score ended before it */
+    if(ended && !until_end && blocks > 0) {
+      if(collect) {
+        memset(out + size, 0, (blocks*len - size)*sizeof(s7_double));
+        size = blocks*len;
+      }
+      n = blocks;
+    }
+    if(!collect) return s7_make_integer(sc, n*ksmps);
+    if(size < cap)
+      res = s7_call(sc, s7_name_to_value(sc, "subvector"),
+                    s7_list(sc, 3, res, s7_make_integer(sc, 0),
+                            s7_make_integer(sc, size)));
+    cs->rendered = prev;
+    return res;
+  } else return cs_type_err(sc, args,"csound-render");
+}
+
 
 static s7_pointer perf_time(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
     int64_t time_frames = csoundGetCurrentTimeSamples(cs->csound);
     double time_secs = time_frames/csoundGetSr(cs->csound);                
@@ -177,84 +2015,644 @@ static s7_pointer perf_time(s7_scheme *sc, s7_pointer args) {
   } else return cs_type_err(sc, args,"csound-time");
 }
 
+static _Thread_local bool in_process_cb = false;
+
+static void process_unstale(cs_obj *cs) {
+  if(cs->stale) s7_gc_unprotect_at(cs->s7, cs->proc_stale);
+  cs->stale = false;
+}
+
+/* process callback, run by the performance thread before each block;
+   the frame is preallocated, so calls only update the vector */
+static void process_cb(void *data) {
+  cs_obj *cs = (cs_obj *) data;
+  s7_pointer frame = atomic_load_explicit(&cs->proc_frame,
+                                          memory_order_acquire);
+  s7_double *v;
+  if(frame == NULL || cs->proc_blocks++ % cs->proc_every) return;
+  if(!rt_ok(get_ctx(cs->csound))) return;
+  v = s7_float_vector_elements(s7_cadr(frame));
+  v[0] = (s7_double) (cs->proc_blocks - 1);
+  v[1] = csoundGetCurrentTimeSamples(cs->csound)/csoundGetSr(cs->csound);
+  cs->proc_running = frame;
+  in_process_cb = true;
+  s7_call(cs->s7, s7_car(frame), s7_cdr(frame));
+  in_process_cb = false;
+  cs->proc_running = NULL;
+  process_unstale(cs);
+}
+
+/* a callback change, made on the engine thread between blocks */
+typedef struct {
+  cs_obj *cs;
+  s7_pointer frame;
+  s7_int loc, every;
+} PROCSWAP;
+
+static void process_swap(void *data) {
+  PROCSWAP *sw = (PROCSWAP *) data;
+  cs_obj *cs = sw->cs;
+  s7_int loc = cs->proc_loc;
+  s7_pointer old = atomic_exchange(&cs->proc_frame, sw->frame);
+  cs->proc_loc = sw->loc;
+  cs->proc_every = sw->every;
+  cs->proc_blocks = 0;
+  if(old == NULL) return;
+  /* the callback replacing itself: the old frame goes once it returns */
+  if(old == cs->proc_running) {
+    process_unstale(cs);
+    cs->proc_stale = loc;
+    cs->stale = true;
+  }
+  else s7_gc_unprotect_at(cs->s7, loc);
+}
+
+static void repl_send(cs_obj *cs, S7CMD *cmd);
+
+/* the swap goes through the command queue, so it happens between
+   blocks, unless it is made from the engine thread itself */
+static void process_set(cs_obj *cs, s7_pointer frame, s7_int loc,
+                        s7_int every) {
+  PROCSWAP sw = { cs, frame, loc, every };
+  S7CMD cmd = { .kind = CMD_CALL, .call = process_swap, .arg = &sw };
+  if(in_cmd_drain || in_process_cb) process_swap(&sw);
+  else repl_send(cs, &cmd);
+}
+
+/* for engines that are not performing */
+static void process_clear(cs_obj *cs) {
+  if(atomic_exchange(&cs->proc_frame, NULL) != NULL)
+    s7_gc_unprotect_at(cs->s7, cs->proc_loc);
+  process_unstale(cs);
+}
+
+/* engine evaluating REPL input, if any */
+static _Atomic(cs_obj *) repl_engine = NULL;
+
+/* a callback runs in the engine interpreter, on the performance
+   thread, so one sharing the REPL interpreter is only installed
+   while REPL input is queued to the engine */
+static s7_pointer set_process(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer proc = s7_cadr(args), every = s7_caddr(args), frame;
+    if(proc == s7_f(sc)) {
+      process_set(cs, NULL, 0, 1);
+      return s7_f(sc);
+    }
+    /* engines with their own interpreter take a procedure name */
+    if(s7_is_string(proc))
+      proc = s7_name_to_value(cs->s7, s7_string(proc));
+    else if(cs->s7 != sc)
+      return s7_wrong_type_arg_error(sc, "csound-set-process-callback", 2,
+                                     proc, "procedure name");
+    if(!s7_is_procedure(proc))
+      return s7_wrong_type_arg_error(sc, "csound-set-process-callback", 2,
+                                     s7_cadr(args), "procedure");
+    if(!s7_is_integer(every) || s7_integer(every) < 1)
+      return s7_wrong_type_arg_error(sc, "csound-set-process-callback", 3,
+                                     every, "positive integer");
+    if(cs->s7 == sc && atomic_load(&repl_engine) != cs)
+      return s7_error(sc, s7_make_symbol(sc, "csound-repl-not-queued"),
+                      s7_list(sc, 1, s7_car(args)));
+    frame = s7_list(cs->s7, 2, proc,
+                    s7_make_float_vector(cs->s7, 2, 1, NULL));
+    process_set(cs, frame, s7_gc_protect(cs->s7, frame), s7_integer(every));
+    return s7_t(sc);
+  } return cs_type_err(sc, args,"csound-set-process-callback");
+}
+
 static s7_pointer start(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
+  if(cs_check(sc, s7_car(args))) {
     cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
     int32_t res;
     bool async;
     if(cs->perf) return s7_make_integer(sc, -1);
+    ipool_setup(cs->csound);
     res = csoundStart(cs->csound);
     async = s7_boolean(sc, s7_cadr(args));
     if(res == CSOUND_SUCCESS && async){
        cs->perf = csoundCreatePerformanceThread(cs->csound);
-       if(cs->perf) csoundPerformanceThreadPlay(cs->perf);
+       if(cs->perf) {
+         gc_perf(get_ctx(cs->csound), true, false);
+         csoundPerformanceThreadSetProcessCallback(cs->perf, process_cb, cs);
+         csoundPerformanceThreadPlay(cs->perf);
+       }
     } 
     return s7_make_integer(sc, res);
   } return cs_type_err(sc, args,"csound-start");
 }
 
-static s7_pointer stop(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
-    int32_t res;
-    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
-    if(cs->perf) {
-      csoundPerformanceThreadStop(cs->perf);
-      csoundPerformanceThreadJoin(cs->perf);
-      csoundDestroyPerformanceThread(cs->perf);
-      cs->perf = NULL;
-    }
-    csoundReset(cs->csound);
-    csoundSetOption(cs->csound, "-odac");
-    if((res = append_opcodes(cs->csound, sc))
-       != CSOUND_SUCCESS)
-      return s7_error(sc, s7_make_symbol(sc, "failed-csound-reset"),
-                      s7_list(sc, 1,  s7_car(s7_make_integer(sc, res)))); 
-    return s7_car(args);
-  } return cs_type_err(sc, args,"csound-stop");
+static void engine_halt(cs_obj *cs) {
+  if(cs->perf) {
+    csoundPerformanceThreadStop(cs->perf);
+    csoundPerformanceThreadJoin(cs->perf);
+    csoundDestroyPerformanceThread(cs->perf);
+    cs->perf = NULL;
+    gc_perf(get_ctx(cs->csound), false, true);
+  }
+  cs->pause = false;
+}
+
+/* stops and resets an engine, deinitialising any instrument
+   instances still active (e.g. in synchronous performance) */
+static void engine_clear(cs_obj *cs) {
+  engine_halt(cs);
+  csoundReset(cs->csound);
+  sched_reclaim(cs, true);
+  cs->epoch++;
+}
+
+/* stops and resets an engine, ready to be started again */
+static int32_t engine_reset(cs_obj *cs) {
+  engine_clear(cs);
+  return engine_setup(cs);
+}
+
+static s7_pointer stop(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    int32_t res;
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    if(in_cmd_drain)
+      return s7_error(sc, s7_make_symbol(sc, "csound-stop-in-perf-thread"),
+                      s7_list(sc, 1, s7_car(args)));
+    if((res = engine_reset(cs)) != CSOUND_SUCCESS)
+      return s7_error(sc, s7_make_symbol(sc, "failed-csound-reset"),
+                      s7_list(sc, 1,  s7_car(s7_make_integer(sc, res)))); 
+    return s7_car(args);
+  } return cs_type_err(sc, args,"csound-stop");
+}
+
+static s7_pointer is_async(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    bool async = false;
+    if(cs->perf) async = true;
+    return s7_make_boolean(sc, async);
+  } return cs_type_err(sc, args,"csound-async?");
+}
+
+static s7_pointer toggle_pause(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    if(cs->perf) {
+     csoundPerformanceThreadTogglePause(cs->perf);
+     /* the pause is taken between blocks */
+     csoundPerformanceThreadFlushMessageQueue(cs->perf);
+     cs->pause = !cs->pause;
+     gc_perf(get_ctx(cs->csound), !cs->pause, false);
+    }
+    return s7_make_integer(sc, cs->pause ? 1 : 0);
+  } return cs_type_err(sc, args,"csound-pause");
+}
+
+static s7_pointer is_paused(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    return s7_make_boolean(sc, cs->pause);
+  } return cs_type_err(sc, args,"csound-paused?");
+}
+
+static s7_pointer gc_stats(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    S7CTX *ctx = get_ctx(cs->csound);
+    return s7_list(sc, 3, s7_make_integer(sc, ctx->gc_runs),
+                   s7_make_integer(sc, ctx->gc_deferred),
+                   s7_make_real(sc, ctx->gc_cost*1e-9));
+  } return cs_type_err(sc, args,"csound-gc-stats");
+}
+
+static s7_pointer s7_profile(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    S7CTX *ctx = get_ctx(cs->csound);
+    s7_pointer lst = s7_nil(sc);
+    S7PROF *r;
+    if(s7_is_pair(s7_cdr(args)))
+      prof_enable(ctx, s7_boolean(sc, s7_cadr(args)));
+    for(r = atomic_load(&ctx->prof); r != NULL; r = r->next)
+      lst = s7_cons(sc, s7_list(sc, 7, s7_make_integer(sc, r->insno),
+                                s7_make_string(sc, r->opname),
+                                s7_make_string(sc, r->code),
+                                s7_make_integer(sc, atomic_load(&r->calls)),
+                                s7_make_real(sc, atomic_load(&r->ns)*1e-9),
+                                s7_make_real(sc,
+                                             atomic_load(&r->max_ns)*1e-9),
+                                s7_make_integer(sc, atomic_load(&r->cells))),
+                    lst);
+    return lst;
+  } return cs_type_err(sc, args,"csound-s7-profile");
+}
+
+static s7_pointer repl_queue(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    bool on = s7_boolean(sc, s7_cadr(args));
+    /* not while a callback may run in the REPL interpreter */
+    if(!on && cs->s7 == sc && cs->perf != NULL &&
+       atomic_load(&cs->proc_frame) != NULL)
+      return s7_error(sc, s7_make_symbol(sc, "csound-process-callback-set"),
+                      s7_list(sc, 1, s7_car(args)));
+    if(on) atomic_store(&repl_engine, cs);
+    else atomic_compare_exchange_strong(&repl_engine, &cs, NULL);
+    return s7_make_boolean(sc, on);
+  } return cs_type_err(sc, args,"csound-repl-queue");
+}
+
+static bool engine_running(cs_obj *cs) {
+  return cs->perf != NULL && !cs->pause &&
+    csoundPerformanceThreadIsRunning(cs->perf);
+}
+
+/* the REPL only uses the engine interpreter directly if there is
+   no performance thread, or it is paused (between blocks) or has
+   finished, in which case it is joined */
+static bool engine_quiet(cs_obj *cs) {
+  if(cs->perf == NULL || cs->pause) return true;
+  if(csoundPerformanceThreadIsRunning(cs->perf)) return false;
+  csoundPerformanceThreadJoin(cs->perf);
+  return true;
+}
+
+/* queues a REPL command and waits for it to be run */
+static void repl_send(cs_obj *cs, S7CMD *cmd) {
+  S7CTX *ctx = get_ctx(cs->csound);
+  struct timespec ts = { 0, 500000 };
+  while(!spsc_push(&ctx->cmds, cmd)) {
+    if(engine_quiet(cs)) cmd_drain(ctx);
+    else nanosleep(&ts, NULL);
+  }
+  for(;;) {
+    S7CMD *done = (S7CMD *) spsc_pop(&ctx->done);
+    if(done == cmd) break;
+    /* performance paused or ended with the command still queued */
+    else if(done == NULL && engine_quiet(cs)) cmd_drain(ctx);
+    else nanosleep(&ts, NULL);
+  }
+}
+
+char *cs_s7_queue_eval(const char *code) {
+  cs_obj *cs = atomic_load(&repl_engine);
+  S7CMD cmd = { .kind = CMD_EVAL, .code = (char *) code };
+  S7CTX *ctx;
+  if(cs == NULL) return NULL;
+  ctx = get_ctx(cs->csound);
+  if(engine_quiet(cs)) {
+    s7_pointer form = read_code(ctx->s7, code);
+    s7_int loc = s7_gc_protect(ctx->s7, form);
+    char *res = s7_object_to_c_string(ctx->s7,
+                                      s7_eval(ctx->s7, form,
+                                              s7_rootlet(ctx->s7)));
+    defs_log(ctx->s7, form);
+    pool_replicate(ctx, form);
+    s7_gc_unprotect_at(ctx->s7, loc);
+    return res;
+  }
+  repl_send(cs, &cmd);
+  return cmd.result;
+}
+
+void cs_s7_log_definitions(s7_scheme *sc, const char *code) {
+  s7_pointer form = read_code(sc, code);
+  s7_int loc = s7_gc_protect(sc, form);
+  defs_log(sc, form);
+  s7_gc_unprotect_at(sc, loc);
+}
+
+/* REPL evaluation of a form, for REPLs that read their input */
+static s7_pointer repl_eval(s7_scheme *sc, s7_pointer args) {
+  cs_obj *cs = atomic_load(&repl_engine);
+  s7_pointer env = s7_is_pair(s7_cdr(args)) ? s7_cadr(args) : s7_rootlet(sc);
+  S7CMD cmd = { .kind = CMD_FORM, .form = s7_car(args), .env = env };
+  if(cs == NULL || cs->s7 != sc || engine_quiet(cs)) {
+    s7_pointer val = s7_eval(sc, s7_car(args), env);
+    s7_int loc = s7_gc_protect(sc, val);
+    defs_log(sc, s7_car(args));
+    if(cs != NULL && cs->s7 == sc)
+      pool_replicate(get_ctx(cs->csound), s7_car(args));
+    s7_gc_unprotect_at(sc, loc);
+    return val;
+  }
+  repl_send(cs, &cmd);
+  s7_gc_unprotect_at(sc, cmd.loc);
+  return cmd.value;
+}
+
+static s7_pointer rt_pool_stats(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    S7POOL *pool = &(get_ctx(cs->csound)->pool);
+    return s7_list(sc, 3, s7_make_integer(sc, atomic_load(&pool->state)),
+                   s7_make_integer(sc, atomic_load(&pool->skipped)),
+                   s7_make_integer(sc, pool->refills));
+  } return cs_type_err(sc, args,"csound-rt-pool-stats");
+}
+
+static s7_pointer msg_severity(s7_scheme *sc, int32_t attr) {
+  switch(attr & CSOUNDMSG_TYPE_MASK) {
+  case CSOUNDMSG_ERROR: return s7_make_symbol(sc, "error");
+  case CSOUNDMSG_ORCH: return s7_make_symbol(sc, "orch");
+  case CSOUNDMSG_REALTIME: return s7_make_symbol(sc, "realtime");
+  case CSOUNDMSG_WARNING: return s7_make_symbol(sc, "warning");
+  case CSOUNDMSG_STDOUT: return s7_make_symbol(sc, "stdout");
+  default: return s7_make_symbol(sc, "message");
+  }
+}
+
+static s7_pointer messages(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    s7_pointer lst = s7_nil(sc);
+    MSGSLOT *slot;
+    if(cs->msgs == NULL) return s7_f(sc);
+    while((slot = msgring_peek(cs->msgs)) != NULL) {
+      lst = s7_cons(sc, s7_list(sc, 3, msg_severity(sc, slot->attr),
+                                s7_make_real(sc, slot->time),
+                                s7_make_string(sc, slot->text)), lst);
+      msgring_next(cs->msgs);
+    }
+    return s7_reverse(sc, lst);
+  } return cs_type_err(sc, args,"csound-messages");
+}
+
+static s7_pointer messages_dropped(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
+    if(cs->msgs == NULL) return s7_f(sc);
+    return s7_make_integer(sc, atomic_load(&cs->msgs->dropped));
+  } return cs_type_err(sc, args,"csound-messages-dropped");
+}
+
+static void engine_destroy(cs_obj *cs) {
+  engine_halt(cs);
+  csoundDestroy(cs->csound);
+  sched_reclaim(cs, true);
+  process_clear(cs);
+  if(cs->interp) interp_release(cs->interp);
+  if(cs->home) interp_release(cs->home);
+  if(cs->msgs) {
+    free(cs->msgs->slots);
+    free(cs->msgs);
+  }
+  free(cs);
+}
+
+static void engine_pool_lost(void);
+
+static s7_pointer free_csobj(s7_scheme *sc, s7_pointer obj){
+  cs_obj *cs = (cs_obj *) s7_c_object_value(obj);
+  atomic_compare_exchange_strong(&repl_engine, &cs, NULL);
+  if(cs->csound != NULL) {
+    if(cs->pooled) engine_pool_lost();
+    engine_destroy(cs);
+  }
+  else free(cs);
+  return NULL;
+}
+
+/* warm engine pool: engines with interpreters of their own, so
+   that they can be created and reset by a background thread. New
+   engines are only made while the warm, released and outstanding
+   ones are fewer than the pool size, so that engines given back
+   are reused rather than replaced. */
+#define ENGINE_POOL_SIZE 2
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  cs_obj *ready, *dirty; // warm engines, released engines
+  int32_t nready, ndirty, nout, size; // nout: taken, not given back
+  bool running;
+  pthread_t thread;
+  uint64_t hits, misses, recycled;
+} engine_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                  NULL, NULL, 0, 0, 0, ENGINE_POOL_SIZE };
+
+static cs_obj *engine_new(void) {
+  cs_obj *cs = (cs_obj *) calloc(1, sizeof(cs_obj));
+  cs->interp = interp_acquire(NULL);
+  cs->s7 = atomic_load(&cs->interp->s7);
+  cs->pooled = true;
+  if((cs->csound = csoundCreate(cs, NULL)) == NULL) {
+    interp_release(cs->interp);
+    free(cs);
+    return NULL;
+  }
+  if(engine_setup(cs) != CSOUND_SUCCESS) {
+    engine_destroy(cs);
+    return NULL;
+  }
+  return cs;
+}
+
+/* resets released engines and keeps the pool filled */
+static void *engine_pool_thread(void *data) {
+  cs_obj *cs;
+  pthread_mutex_lock(&engine_pool.lock);
+  while(engine_pool.running) {
+    if((cs = engine_pool.dirty) != NULL) {
+      bool keep;
+      engine_pool.dirty = cs->pool_next;
+      pthread_mutex_unlock(&engine_pool.lock);
+      process_clear(cs);
+      if(!cs->cleared) engine_clear(cs);
+      cs->cleared = false;
+      /* engines that captured messages are not passed on */
+      keep = engine_setup(cs) == CSOUND_SUCCESS && cs->msgs == NULL;
+      pthread_mutex_lock(&engine_pool.lock);
+      engine_pool.ndirty--;
+      if(keep && engine_pool.nready < engine_pool.size) {
+        engine_pool.recycled++;
+        cs->pool_next = engine_pool.ready;
+        engine_pool.ready = cs;
+        engine_pool.nready++;
+        continue;
+      }
+      pthread_mutex_unlock(&engine_pool.lock);
+      engine_destroy(cs);
+      pthread_mutex_lock(&engine_pool.lock);
+    } else if(engine_pool.nready + engine_pool.ndirty + engine_pool.nout
+              < engine_pool.size) {
+      pthread_mutex_unlock(&engine_pool.lock);
+      cs = engine_new();
+      pthread_mutex_lock(&engine_pool.lock);
+      if(cs == NULL)
+        pthread_cond_wait(&engine_pool.cond, &engine_pool.lock);
+      else {
+        cs->pool_next = engine_pool.ready;
+        engine_pool.ready = cs;
+        engine_pool.nready++;
+      }
+    } else pthread_cond_wait(&engine_pool.cond, &engine_pool.lock);
+  }
+  pthread_mutex_unlock(&engine_pool.lock);
+  return NULL;
+}
+
+/* stops and joins the pool thread at exit, then destroys the
+   engines it holds */
+static void engine_pool_shutdown(void) {
+  cs_obj *cs, *next;
+  pthread_mutex_lock(&engine_pool.lock);
+  if(!engine_pool.running) {
+    pthread_mutex_unlock(&engine_pool.lock);
+    return;
+  }
+  engine_pool.running = false;
+  pthread_cond_signal(&engine_pool.cond);
+  pthread_mutex_unlock(&engine_pool.lock);
+  pthread_join(engine_pool.thread, NULL);
+  for(cs = engine_pool.ready; cs != NULL; cs = next) {
+    next = cs->pool_next;
+    engine_destroy(cs);
+  }
+  for(cs = engine_pool.dirty; cs != NULL; cs = next) {
+    next = cs->pool_next;
+    engine_destroy(cs);
+  }
+  engine_pool.ready = engine_pool.dirty = NULL;
+  engine_pool.nready = engine_pool.ndirty = 0;
+}
+
+/* called with the lock held */
+static void engine_pool_wake(void) {
+  static bool registered = false;
+  if(!engine_pool.running) {
+    engine_pool.running = true;
+    pthread_create(&engine_pool.thread, NULL, engine_pool_thread, NULL);
+    if(!registered) registered = atexit(engine_pool_shutdown) == 0;
+  } else pthread_cond_signal(&engine_pool.cond);
+}
+
+/* a taken engine that will not be given back (collected, or
+   not created), so the pool may make a new one */
+static void engine_pool_lost(void) {
+  pthread_mutex_lock(&engine_pool.lock);
+  engine_pool.nout--;
+  if(engine_pool.running) pthread_cond_signal(&engine_pool.cond);
+  pthread_mutex_unlock(&engine_pool.lock);
 }
 
-static s7_pointer is_async(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
-    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
-    bool async = false;
-    if(cs->perf) async = true;
-    return s7_make_boolean(sc, async);
-  } return cs_type_err(sc, args,"csound-async?");
+/* points the engine (its opcodes and GC control) at cs->s7 */
+static void engine_bind(cs_obj *cs) {
+  s7_scheme **s7p = (s7_scheme **)
+    cs->csound->QueryGlobalVariable(cs->csound, "_S7_");
+  S7CTX *ctx = get_ctx(cs->csound);
+  if(s7p != NULL) *s7p = cs->s7;
+  if(ctx != NULL) ctx->s7 = cs->s7;
 }
 
-static s7_pointer toggle_pause(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
-    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
-    if(cs->perf) {
-     csoundPerformanceThreadTogglePause(cs->perf);
-     cs->pause = !cs->pause;
+/* a pooled engine takes the make-csound options: unless interp
+   is #t, it is bound to the caller's (or the named) interpreter,
+   keeping its own for when it is given back */
+static s7_pointer pool_acquire(s7_scheme *sc, s7_pointer args) {
+  cs_obj *cs;
+  pthread_mutex_lock(&engine_pool.lock);
+  if((cs = engine_pool.ready) != NULL) {
+    engine_pool.ready = cs->pool_next;
+    engine_pool.nready--;
+    engine_pool.hits++;
+  } else engine_pool.misses++;
+  engine_pool.nout++;
+  engine_pool_wake();
+  pthread_mutex_unlock(&engine_pool.lock);
+  if(cs == NULL && (cs = engine_new()) == NULL) {
+    engine_pool_lost();
+    return s7_error(sc, s7_make_symbol(sc, "failed-csound-create"),
+                    s7_nil(sc));
+  }
+  cs->pool_next = NULL;
+  if(s7_cadddr(args) != s7_t(sc)) {
+    cs->home = cs->interp;
+    cs->interp = NULL;
+  }
+  engine_opts(sc, cs, args);
+  engine_bind(cs);
+  if(cs->msgs != NULL) csoundSetMessageCallback(cs->csound, msg_callback);
+  gc_setup(cs->csound, cs->heap_size, cs->gc_budget, cs->rt_pool);
+  return s7_make_c_object(sc, cs_type_tag(sc), (void *) cs);
+}
+
+/* the engine moves to a new record, leaving the object empty */
+static s7_pointer pool_release(s7_scheme *sc, s7_pointer args) {
+  if(cs_check(sc, s7_car(args))) {
+    cs_obj *cs = (cs_obj *) s7_c_object_value(s7_car(args)), *e;
+    uint64_t epoch;
+    if(!cs->pooled)
+      return s7_wrong_type_arg_error(sc, "csound-pool-release", 1,
+                                     s7_car(args), "pooled csound-obj");
+    if(in_cmd_drain)
+      return s7_error(sc, s7_make_symbol(sc, "csound-stop-in-perf-thread"),
+                      s7_list(sc, 1, s7_car(args)));
+    atomic_compare_exchange_strong(&repl_engine, &cs, NULL);
+    engine_halt(cs);
+    process_clear(cs);
+    /* instances still active keep objects in the caller's
+       interpreter, so they are deinitialised here, before the
+       engine is bound back to its own */
+    if(cs->home != NULL) {
+      engine_clear(cs);
+      cs->cleared = true;
     }
-    return s7_make_integer(sc, cs->pause ? 1 : 0);
-  } return cs_type_err(sc, args,"csound-pause");
+    e = (cs_obj *) malloc(sizeof(cs_obj));
+    memcpy(e, cs, sizeof(cs_obj));
+    e->views[VIEW_SPIN] = e->views[VIEW_SPOUT] = NULL;
+    csoundSetHostData(e->csound, e);
+    /* back to its own interpreter and default options, so that the
+       pool thread does not touch the caller's */
+    if(e->home != NULL) {
+      if(e->interp != NULL) interp_release(e->interp);
+      e->interp = e->home;
+      e->home = NULL;
+      e->s7 = atomic_load(&e->interp->s7);
+      engine_bind(e);
+    }
+    e->heap_size = e->rt_pool = 0;
+    e->gc_budget = 0.;
+    /* the object keeps a new epoch, so channel handles on it fail */
+    epoch = cs->epoch + 1;
+    memset(cs, 0, sizeof(cs_obj));
+    cs->epoch = epoch ? epoch : 1;
+    pthread_mutex_lock(&engine_pool.lock);
+    e->pool_next = engine_pool.dirty;
+    engine_pool.dirty = e;
+    engine_pool.ndirty++;
+    engine_pool.nout--;
+    engine_pool_wake();
+    pthread_mutex_unlock(&engine_pool.lock);
+    return s7_t(sc);
+  } return cs_type_err(sc, args,"csound-pool-release");
 }
 
-static s7_pointer is_paused(s7_scheme *sc, s7_pointer args) {
-  if(cs_check(s7_car(args))) {
-    cs_obj *cs  = (cs_obj *) s7_c_object_value(s7_car(args));
-    return s7_make_boolean(sc, cs->pause);
-  } return cs_type_err(sc, args,"csound-paused?");
+static s7_pointer pool_stats(s7_scheme *sc, s7_pointer args) {
+  s7_pointer res;
+  pthread_mutex_lock(&engine_pool.lock);
+  if(s7_is_integer(s7_car(args)) && s7_integer(s7_car(args)) >= 0) {
+    engine_pool.size = (int32_t) s7_integer(s7_car(args));
+    engine_pool_wake();
+  }
+  res = s7_list(sc, 5, s7_make_integer(sc, engine_pool.hits),
+                s7_make_integer(sc, engine_pool.misses),
+                s7_make_integer(sc, engine_pool.recycled),
+                s7_make_integer(sc, engine_pool.nready),
+                s7_make_integer(sc, engine_pool.size));
+  pthread_mutex_unlock(&engine_pool.lock);
+  return res;
 }
 
-static s7_pointer free_csobj(s7_scheme *sc, s7_pointer obj){
+/* keeps the spin/spout views and the output being rendered */
+static s7_pointer mark_csobj(s7_scheme *sc, s7_pointer obj){
   cs_obj *cs = (cs_obj *) s7_c_object_value(obj);
-  if(cs->perf) {
-    csoundPerformanceThreadStop(cs->perf);
-    csoundPerformanceThreadJoin(cs->perf);
-    csoundDestroyPerformanceThread(cs->perf);
-  }
-  csoundDestroy(cs->csound);
-  free(s7_c_object_value(obj));
+  if(cs->views[VIEW_SPIN] != NULL) s7_mark(cs->views[VIEW_SPIN]);
+  if(cs->views[VIEW_SPOUT] != NULL) s7_mark(cs->views[VIEW_SPOUT]);
+  if(cs->rendered != NULL) s7_mark(cs->rendered);
   return NULL;
 }
 
 static s7_pointer is_csobj(s7_scheme *sc, s7_pointer args){
   return s7_make_boolean(sc,s7_is_c_object(s7_car(args)) &&
-			 s7_c_object_type(s7_car(args)) == cs_type_tag);
+			 s7_c_object_type(s7_car(args)) == cs_type_tag(sc));
 }
 
 static s7_pointer csobj_is_equal(s7_scheme *sc, s7_pointer args){
@@ -264,7 +2662,7 @@ static s7_pointer csobj_is_equal(s7_scheme *sc, s7_pointer args){
   if (p1 == p2)
     return(s7_t(sc));
   if ((!s7_is_c_object(p2)) ||
-      (s7_c_object_type(p2) != cs_type_tag))
+      (s7_c_object_type(p2) != cs_type_tag(sc)))
     return s7_f(sc);
   obj1 = (cs_obj *) s7_c_object_value(p1);
   obj2 = (cs_obj *) s7_c_object_value(p2);
@@ -278,17 +2676,57 @@ static s7_pointer csobj_is_equal(s7_scheme *sc, s7_pointer args){
  **/
 int32_t cs_s7(s7_scheme *sc) {
   int32_t res = csoundInitialize(0);
+  /* positive if already initialised (e.g. by another interpreter) */
+  if(res > 0) res = CSOUND_SUCCESS;
   if(res == CSOUND_SUCCESS) {
-    cs_type_tag = s7_make_c_type(sc, "csound-obj");
-    s7_c_type_set_gc_free(sc,cs_type_tag,free_csobj);
-    s7_c_type_set_is_equal(sc,cs_type_tag,csobj_is_equal);
-    s7_define_function(sc,"make-csound",create,0,0,false,
-                       "(make-csound) creates a csound-obj");
+    int cs_tag = s7_make_c_type(sc, "csound-obj");
+    int ch_tag = s7_make_c_type(sc, "csound-channel");
+    S7INTERP *e;
+    s7_c_type_set_gc_free(sc,cs_tag,free_csobj);
+    s7_c_type_set_is_equal(sc,cs_tag,csobj_is_equal);
+    s7_c_type_set_gc_mark(sc,cs_tag,mark_csobj);
+    s7_c_type_set_gc_free(sc, ch_tag, free_chobj);
+    s7_c_type_set_gc_mark(sc, ch_tag, mark_chobj);
+    pthread_mutex_lock(&interps_lock);
+    e = interp_register(sc, "main", false);
+    e->cs_tag = cs_tag;
+    e->ch_tag = ch_tag;
+    pthread_mutex_unlock(&interps_lock);
+    s7_define_function_star(sc,"make-csound",create,
+                            "(heap-size #f) (gc-budget #f) (rt-pool #f) "
+                            "(interp #f) (messages #f)",
+                            "(make-csound (heap-size #f) (gc-budget #f) "
+                            "(rt-pool #f) (interp #f) (messages #f)) "
+                            "creates a csound-obj, optionally setting the "
+                            "s7 heap size, a per-k-cycle GC budget (ms) "
+                            "or a real-time pool size (cells). If interp "
+                            "is #t, the engine gets its own interpreter, "
+                            "if it is a string, it uses the interpreter "
+                            "of that name, created if needed. If messages "
+                            "is #t or a size, Csound messages are captured "
+                            "in a buffer (see csound-messages)");
     s7_define_function_star(sc,"csound-start", start,
                             "csound-obj (async #t)",
                             "(csound-start csound-obj (async 1)) "
                             "starts csound performance "
                             "(defaults to asynchronous)");
+    s7_define_function_star(sc,"csound-set-process-callback", set_process,
+                            "csound-obj proc (every 1)",
+                            "(csound-set-process-callback csound-obj proc "
+                            "(every 1)) calls proc from the performance "
+                            "thread before every block (or every nth "
+                            "block) with a float-vector #(block secs); "
+                            "#f removes it");
+    s7_define_function_star(sc,"csound-render", render,
+                            "csound-obj (seconds #f) (frames #f) "
+                            "(until-end #t) (hook #f) (every 1) "
+                            "(collect #f)",
+                            "(csound-render csound-obj (seconds #f) "
+                            "(frames #f) (until-end #t) (hook #f) (every 1) "
+                            "(collect #f)) "
+                            "renders a synchronous performance, returning "
+                            "the number of frames or, if collect is #t, "
+                            "the output as a float-vector");
     s7_define_function(sc,"csound-stop",stop,1,0,false,
                        "(csound-stop csound-obj) starts csound performance");
     s7_define_function(sc,"csound-async?", is_async,1,0,false,
@@ -306,9 +2744,24 @@ int32_t cs_s7(s7_scheme *sc) {
     s7_define_function(sc,"csound-event-string",event_string,2,0,false,
                        "(csound-event-string csound_obj evt-string) "
                        "sends an event string");
-    s7_define_function(sc,"csound-event",event,5, 251, false,
+    s7_define_function(sc,"csound-event",event,5, 0, true,
                        "(csound-event csound_obj type p1 p2 p3 ...) "
                        "sends an event");
+    s7_define_function(sc,"csound-event-at",event_at,6, 0, true,
+                       "(csound-event-at csound_obj frame type p1 p2 p3 ...) "
+                       "schedules an event for a given sample frame "
+                       "(p2 is taken from that frame)");
+    s7_define_function_star(sc,"csound-ramp",ramp,
+                            "csound_obj lane target dur (curve 0)",
+                            "(csound-ramp csound_obj lane target dur "
+                            "(curve 0)) queues a ramp to target over dur "
+                            "seconds on an automation lane, read by the "
+                            "s7ramp opcode (curve as in transeg)");
+    s7_define_function(sc,"csound-events",events,3, 0, false,
+                       "(csound-events csound_obj type events) "
+                       "sends a batch of events, given as a list of "
+                       "pfield lists or a 2D float-vector (one event "
+                       "per row)");
     s7_define_function(sc,"csound-compile-string",compile_string,2,0,false,
                        "(csound-compile-string csound_obj code-string) "
                        "compiles a code string");
@@ -318,6 +2771,39 @@ int32_t cs_s7(s7_scheme *sc) {
     s7_define_function(sc,"csound-set-channel",set_channel,3,0,false,
                        "(csound-set-channel csound_obj channel val)"
                        " sets bus channel to val");
+   s7_define_function(sc,"csound-channel", channel, 2, 0, false,
+                      "(csound-channel csound-obj name) "
+                      "returns a handle to a control channel, or to "
+                      "several, if name is a list of names");
+   s7_define_function(sc,"csound-channel-ref", channel_ref, 1, 1, false,
+                      "(csound-channel-ref handle (vec)) "
+                      "returns the channel value or, for several channels, "
+                      "a float-vector with their values (filling vec, if "
+                      "given)");
+   s7_define_function(sc,"csound-channel-set!", channel_set, 2, 0, false,
+                      "(csound-channel-set! handle val) "
+                      "sets the channel value, or for several channels, "
+                      "their values from a float-vector or list");
+   s7_define_function(sc,"csound-table", table, 2, 0, false,
+                      "(csound-table csound-obj n) "
+                      "returns function table n as a float-vector");
+   s7_define_function(sc,"csound-table-copy-in", table_copy_in, 3, 1, false,
+                      "(csound-table-copy-in csound-obj n vec (start 0)) "
+                      "copies a float-vector into function table n, "
+                      "returning the number of values copied");
+   s7_define_function(sc,"csound-table-copy-out", table_copy_out, 2, 2,
+                      false,
+                      "(csound-table-copy-out csound-obj n (vec) (start 0)) "
+                      "copies function table n into a float-vector "
+                      "(vec, if given), which is returned");
+   s7_define_function(sc,"csound-spin", spin, 1, 0, false,
+                      "(csound-spin csound-obj) "
+                      "returns the engine input buffer (interleaved, "
+                      "ksmps frames) as a float-vector");
+   s7_define_function(sc,"csound-spout", spout, 1, 0, false,
+                      "(csound-spout csound-obj) "
+                      "returns the engine output buffer (interleaved, "
+                      "ksmps frames) as a float-vector");
    s7_define_function(sc,"csound-time", perf_time, 1, 0, false,
                        "(csound-time csound-obj) "
                        "returns the current performance time "
@@ -325,6 +2811,56 @@ int32_t cs_s7(s7_scheme *sc) {
    s7_define_function(sc,"csound-perform-ksmps", perf_ksmps, 1, 0, false,
                       "(csound-perform-ksmps csound-obj) "
                       "perform a ksmps-block of frames, synchronously.");
+   s7_define_function(sc,"csound-gc-stats", gc_stats, 1, 0, false,
+                      "(csound-gc-stats csound-obj) "
+                      "returns a list with the number of k-cycle "
+                      "s7 collections, the number of deferred ones and "
+                      "the duration of the last collection (secs)");
+   s7_define_function(sc,"csound-rt-pool-stats", rt_pool_stats, 1, 0, false,
+                      "(csound-rt-pool-stats csound-obj) "
+                      "returns a list with the real-time pool state "
+                      "(0 ready, 1 exhausted), "
+                      "the number of s7 calls skipped by opcodes and "
+                      "the number of refills");
+   s7_define_function(sc,"csound-s7-profile", s7_profile, 1, 1, false,
+                      "(csound-s7-profile csound-obj (on)) "
+                      "returns the s7 opcode profile as a list of "
+                      "(instr opcode code calls total-secs max-secs cells) "
+                      "records, optionally switching profiling on or off "
+                      "first (on clears the records)");
+   s7_define_function(sc,"csound-messages", messages, 1, 0, false,
+                      "(csound-messages csound-obj) "
+                      "drains the captured Csound messages, returning "
+                      "a list of (severity secs text) records, or #f if "
+                      "messages are not captured");
+   s7_define_function(sc,"csound-messages-dropped", messages_dropped,
+                      1, 0, false,
+                      "(csound-messages-dropped csound-obj) "
+                      "returns the number of messages dropped because "
+                      "the capture buffer was full");
+   s7_define_function_star(sc,"csound-pool-acquire", pool_acquire,
+                           "(heap-size #f) (gc-budget #f) (rt-pool #f) "
+                           "(interp #f) (messages #f)",
+                           "(csound-pool-acquire (heap-size #f) "
+                           "(gc-budget #f) (rt-pool #f) (interp #f) "
+                           "(messages #f)) returns a warm csound-obj from "
+                           "the engine pool, taking the make-csound "
+                           "options");
+   s7_define_function(sc,"csound-pool-release", pool_release, 1, 0, false,
+                      "(csound-pool-release csound-obj) "
+                      "returns a pooled engine to be reset and reused");
+   s7_define_function(sc,"csound-pool-stats", pool_stats, 0, 1, false,
+                      "(csound-pool-stats (size)) "
+                      "returns a list with the pool hits, misses, "
+                      "recycled engines, warm engines and pool size, "
+                      "optionally setting the size first");
+   s7_define_function(sc,"csound-repl-queue", repl_queue, 2, 0, false,
+                      "(csound-repl-queue csound-obj on) "
+                      "if on is #t, REPL input is queued and evaluated "
+                      "by the performance thread at k-cycle boundaries");
+   s7_define_function(sc,"csound-repl-eval", repl_eval, 1, 1, false,
+                      "(csound-repl-eval form (env (rootlet))) "
+                      "evaluates form, through the REPL queue if it is on");
    s7_define_function(sc, "csound?", is_csobj, 1, 0, false,
                        "(csound? anything) "
                        "returns #t if its argument is a csound object");
@@ -378,47 +2914,861 @@ typedef struct {
   S7OBJ *out;
   STRINGDAT *code;
   s7_scheme *s7;
+  S7CTX *ctx;
+  s7_pointer form;
+  AUXCH aux;
+  s7_pointer *forms;  /* for each pool interpreter */
+  S7PROF *prof;
 } OPCO;
 
-typedef struct {
+typedef struct opci {
   OPDS h;
   STRINGDAT *code;
   S7OBJ *in;
   s7_scheme *s7;
+  S7CTX *ctx;
+  struct opci *next, *prev; /* in the replication list */
+  int32_t slot;  /* where it was last defined */
+  bool dirty, obj;
+  S7PROF *prof;
 } OPCI;
 
+/* code strings are read once into a (begin ...) form and kept in
+   a hash table held by the interpreter (*s7eval-cache*), so
+   instances evaluating the same string share the parsed code */
+static s7_pointer code_form(CSOUND *csound, s7_scheme *s7, const char *code) {
+  s7_pointer cache = s7_name_to_value(s7, "*s7eval-cache*");
+  s7_pointer key, form;
+  s7_int loc;
+  if(!s7_is_hash_table(cache)) {
+    cache = s7_make_hash_table(s7, 64);
+    s7_define_variable(s7, "*s7eval-cache*", cache);
+  }
+  key = s7_make_string(s7, code);
+  form = s7_hash_table_ref(s7, cache, key);
+  if(form == s7_f(s7)) {
+    size_t len = strlen(code) + 10;
+    char *src = (char *) csound->Malloc(csound, len);
+    s7_pointer port;
+    snprintf(src, len, "(begin\n%s\n)", code);
+    loc = s7_gc_protect(s7, key);
+    port = s7_open_input_string(s7, src);
+    form = s7_read(s7, port);
+    s7_hash_table_set(s7, cache, key, form);
+    s7_close_input_port(s7, port);
+    s7_gc_unprotect_at(s7, loc);
+    csound->Free(csound, src);
+  }
+  return form;
+}
+
+static int32_t interp_init(CSOUND *csound, OPCO *p) {
+  S7CTX *ctx;
+  int32_t i;
+  op_ctx(csound, &p->ctx, &p->s7);
+  ctx = p->ctx;
+  if(!rt_ok(ctx))
+    return csound->InitError(csound, "s7eval: s7 pool exhausted");
+  p->form = code_form(csound, p->s7, (const char*) p->code->data);
+  p->prof = prof_find(csound, ctx, &p->h, "s7eval",
+                      (const char*) p->code->data);
+  if(ctx->npool > 0) {
+    if(p->aux.auxp == NULL || p->aux.size < ctx->npool*sizeof(s7_pointer))
+      csound->AuxAlloc(csound, ctx->npool*sizeof(s7_pointer), &p->aux);
+    p->forms = (s7_pointer *) p->aux.auxp;
+    for(i = 0; i < ctx->npool; i++)
+      p->forms[i] = code_form(csound, ctx->ipool[i],
+                              (const char*) p->code->data);
+  }
+  return OK;
+}
+
+/* interpreter and code form for the calling thread */
+static inline bool op_interp(OPCO *p, s7_scheme **s7, s7_pointer *form) {
+  int32_t slot = thread_slot(p->ctx);
+  if(LIKELY(slot == 0)) {
+    *s7 = p->s7;
+    *form = p->form;
+    return true;
+  }
+  if(slot < 0 || p->forms == NULL) return false;
+  *s7 = p->ctx->ipool[slot-1];
+  *form = p->forms[slot-1];
+  return true;
+}
+
+/* objects kept by an opcode in each interpreter it may run in
+   (indexed by slot), gc-protected in their own heap; a slot is
+   only changed at init-time or by the thread that owns it */
+typedef struct {
+  s7_pointer obj;
+  s7_int loc;
+  MYFLT *data;    /* s7vector: array memory the vector was made for */
+  s7_int len;
+} SLOTOBJ;
+
+static SLOTOBJ *slots_alloc(CSOUND *csound, S7CTX *ctx, AUXCH *aux,
+                            int32_t *n) {
+  size_t size = (ctx->npool + 1)*sizeof(SLOTOBJ);
+  if(aux->auxp == NULL || aux->size < size)
+    csound->AuxAlloc(csound, size, aux);
+  *n = ctx->npool + 1;
+  return (SLOTOBJ *) aux->auxp;
+}
+
+static void slot_keep(S7CTX *ctx, SLOTOBJ *o, int32_t slot, s7_pointer obj) {
+  s7_scheme *s7 = slot_interp(ctx, slot);
+  if(o[slot].obj != NULL) s7_gc_unprotect_at(s7, o[slot].loc);
+  o[slot].obj = obj;
+  if(obj != NULL) o[slot].loc = s7_gc_protect(s7, obj);
+}
+
+/* objects in interpreters already freed with the pool are dropped */
+static void slots_free(S7CTX *ctx, SLOTOBJ *o, int32_t n) {
+  int32_t i;
+  for(i = 0; o != NULL && i < n; i++) {
+    if(i <= ctx->npool) slot_keep(ctx, o, i, NULL);
+    else o[i].obj = NULL;
+  }
+}
+
+/* slot of the calling thread, if the opcode has an object there */
+static inline int32_t op_slot(S7CTX *ctx, SLOTOBJ *o, int32_t n) {
+  int32_t slot = thread_slot(ctx);
+  return slot >= 0 && slot < n && o[slot].obj != NULL ? slot : -1;
+}
+
+static inline MYFLT to_myflt(s7_pointer res) {
+  if(s7_is_real(res)) return (MYFLT) s7_real(res);
+  else if(s7_is_integer(res)) return (MYFLT) s7_integer(res);
+  else return FL(0.0);
+}
+
 static int32_t  interp_call_myflt(CSOUND *csound, OPCO *p) {
   MYFLT *out = (MYFLT *) p->out;
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
-  s7_pointer res = s7_eval_c_string(p->s7, (const char*) p->code->data);
-  if(s7_is_real(res)) *out = s7_real(res);
-  else if(s7_is_integer(res)) *out = (MYFLT) s7_integer(res);
-  else *out = 0.;
+  s7_scheme *s7;
+  s7_pointer form;
+  PROFT t;
+  bool prof = prof_on(p->ctx, p->prof);
+  if(!rt_ok(p->ctx) || !op_interp(p, &s7, &form)) return OK;
+  if(prof) prof_start(p->ctx, thread_slot(p->ctx), &t);
+  *out = to_myflt(s7_eval(s7, form, s7_rootlet(s7)));
+  if(prof) prof_end(p->ctx, p->prof, thread_slot(p->ctx), &t);
+  return OK;
+}
+
+/* init-time evaluations log any definitions they make and,
+   with a pool, run them there too */
+static void interp_defs(OPCO *p) {
+  defs_log(p->s7, p->form);
+  pool_replicate(p->ctx, p->form);
+}
+
+static int32_t  interp_init_myflt(CSOUND *csound, OPCO *p) {
+  if(interp_init(csound, p) != OK) return NOTOK;
+  interp_defs(p);
+  return interp_call_myflt(csound, p);
+}
+
+static int32_t  interp_call(CSOUND *csound, OPCO *p) {
+  s7_scheme *s7;
+  s7_pointer form;
+  PROFT t;
+  bool prof = prof_on(p->ctx, p->prof);
+  if(!rt_ok(p->ctx) || !op_interp(p, &s7, &form)) return OK;
+  if(prof) prof_start(p->ctx, thread_slot(p->ctx), &t);
+  p->out->obj = s7_eval(s7, form, s7_rootlet(s7));
+  if(prof) prof_end(p->ctx, p->prof, thread_slot(p->ctx), &t);
+  return OK;
+}
+
+static int32_t  interp_init_call(CSOUND *csound, OPCO *p) {
+  if(interp_init(csound, p) != OK) return NOTOK;
+  interp_defs(p);
+  return interp_call(csound, p);
+}
+
+/* k-rate definitions are made in the interpreter of the calling
+   thread and copied to the others at the next k-cycle boundary */
+static void defs_replicate(S7CTX *ctx) {
+  OPCI *p;
+  for(p = (OPCI *) ctx->defs; p != NULL; p = p->next) {
+    if(!p->dirty) continue;
+    p->dirty = false;
+    if(p->obj)
+      pool_define(ctx, p->slot, (const char*) p->code->data,
+                  s7_name_to_value(slot_interp(ctx, p->slot),
+                                   (const char*) p->code->data));
+    else
+      pool_define(ctx, p->slot, (const char*) p->code->data,
+                  s7_make_real(ctx->s7, *((MYFLT *)p->in)));
+  }
+}
+
+static int32_t define_deinit(CSOUND *csound, OPCI *p) {
+  if(p->ctx == NULL) return OK;
+  if(p->prev != NULL) p->prev->next = p->next;
+  else if(p->ctx->defs == p) p->ctx->defs = p->next;
+  if(p->next != NULL) p->next->prev = p->prev;
+  p->next = p->prev = NULL;
+  return OK;
+}
+
+static int32_t define_init(CSOUND *csound, OPCI *p) {
+  op_ctx(csound, &p->ctx, &p->s7);
+  define_deinit(csound, p);
+  p->dirty = false;
+  p->prof = prof_find(csound, p->ctx, &p->h, "s7definevar",
+                      (const char*) p->code->data);
+  if(p->ctx->npool > 0) {
+    p->next = (OPCI *) p->ctx->defs;
+    if(p->next != NULL) p->next->prev = p;
+    p->ctx->defs = p;
+  }
   return OK;
 }
 
 static int32_t define_var_myflt(CSOUND *csound, OPCI *p) {
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
+  int32_t slot = thread_slot(p->ctx);
+  s7_scheme *s7;
+  PROFT t;
+  bool prof = prof_on(p->ctx, p->prof);
+  if(!rt_ok(p->ctx) || slot < 0) return OK;
+  s7 = slot_interp(p->ctx, slot);
+  if(prof) prof_start(p->ctx, slot, &t);
+  s7_define_variable(s7, (const char*) p->code->data,
+                     s7_make_real(s7, *((MYFLT *)p->in)));
+  if(prof) prof_end(p->ctx, p->prof, slot, &t);
+  p->slot = slot;
+  p->dirty = p->ctx->npool > 0;
+  return OK;
+}
+
+static int32_t define_var_myflt_init(CSOUND *csound, OPCI *p) {
+  PROFT t;
+  op_ctx(csound, &p->ctx, &p->s7);
+  if(!rt_ok(p->ctx)) return OK;
+  p->prof = prof_find(csound, p->ctx, &p->h, "s7definevar",
+                      (const char*) p->code->data);
+  if(p->prof) prof_start(p->ctx, 0, &t);
   s7_define_variable(p->s7, (const char*) p->code->data,
                      s7_make_real(p->s7, *((MYFLT *)p->in)));
+  if(p->prof) prof_end(p->ctx, p->prof, 0, &t);
+  if(p->ctx->npool > 0)
+    pool_define(p->ctx, 0, (const char*) p->code->data,
+                s7_make_real(p->s7, *((MYFLT *)p->in)));
   return OK;
 }
 
-static int32_t  interp_call(CSOUND *csound, OPCO *p) {
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
-  p->out->obj = s7_eval_c_string(p->s7, (const char*) p->code->data);
+static int32_t define_var(CSOUND *csound, OPCI *p) {
+  int32_t slot = thread_slot(p->ctx);
+  PROFT t;
+  bool prof = prof_on(p->ctx, p->prof);
+  if(!rt_ok(p->ctx) || slot < 0) return OK;
+  if(p->in->obj) {
+    s7_scheme *s7 = slot_interp(p->ctx, slot);
+    if(prof) prof_start(p->ctx, slot, &t);
+    /* with a pool, the object may come from another heap */
+    if(p->ctx->npool > 0) {
+      char *text = s7_object_to_c_string(s7, p->in->obj);
+      s7_define_variable(s7, (const char*) p->code->data,
+                         read_text(s7, text));
+      free(text);
+    }
+    else s7_define_variable(s7, (const char*) p->code->data, p->in->obj);
+    if(prof) prof_end(p->ctx, p->prof, slot, &t);
+    p->slot = slot;
+    p->obj = true;
+    p->dirty = p->ctx->npool > 0;
+  }
   return OK;
 }
 
-static int32_t define_var(CSOUND *csound, OPCI *p) {
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
-  if(p->in->obj)
+static int32_t define_var_init(CSOUND *csound, OPCI *p) {
+  PROFT t;
+  define_init(csound, p);
+  if(!rt_ok(p->ctx)) return OK;
+  if(p->in->obj) {
+    if(p->prof) prof_start(p->ctx, 0, &t);
     s7_define_variable(p->s7, (const char*) p->code->data,
-                     p->in->obj);
+                       p->in->obj);
+    if(p->prof) prof_end(p->ctx, p->prof, 0, &t);
+    if(p->ctx->npool > 0)
+      pool_define(p->ctx, 0, (const char*) p->code->data, p->in->obj);
+  }
+  return OK;
+}
+
+typedef struct {
+  OPDS h;
+  S7OBJ *out;
+  STRINGDAT *name;
+  MYFLT *args[VARGMAX];
+  s7_scheme *s7;
+  S7CTX *ctx;
+  AUXCH aux;
+  SLOTOBJ *frames;  /* (proc . args) in each interpreter */
+  int32_t nslots;
+  S7PROF *prof;
+} OPCALL;
+
+static int32_t call_deinit(CSOUND *csound, OPCALL *p) {
+  if(p->ctx != NULL) slots_free(p->ctx, p->frames, p->nslots);
+  return OK;
+}
+
+/* the procedure is resolved once and the argument list is
+   preallocated, so calls only update the list elements; this
+   is done in every interpreter where the procedure is defined */
+static int32_t call_init(CSOUND *csound, OPCALL *p) {
+  const char *name = (const char *) p->name->data;
+  int32_t i, j, n = p->INOCOUNT - 1;
+  op_ctx(csound, &p->ctx, &p->s7);
+  call_deinit(csound, p);
+  if(!rt_ok(p->ctx))
+    return csound->InitError(csound, "s7call: s7 pool exhausted");
+  if(!s7_is_procedure(s7_name_to_value(p->s7, name)))
+    return csound->InitError(csound, "s7call: %s is not a procedure", name);
+  p->frames = slots_alloc(csound, p->ctx, &p->aux, &p->nslots);
+  for(i = 0; i < p->nslots; i++) {
+    s7_scheme *s7 = slot_interp(p->ctx, i);
+    s7_pointer proc = s7_name_to_value(s7, name), argp;
+    if(!s7_is_procedure(proc)) continue;
+    slot_keep(p->ctx, p->frames, i, s7_cons(s7, proc, s7_nil(s7)));
+    s7_set_cdr(p->frames[i].obj, s7_make_list(s7, n, s7_f(s7)));
+    for(j = 0, argp = s7_cdr(p->frames[i].obj); j < n;
+        j++, argp = s7_cdr(argp))
+      s7_set_car(argp, s7_make_real(s7, *p->args[j]));
+  }
+  p->prof = prof_find(csound, p->ctx, &p->h, "s7call", name);
+  return OK;
+}
+
+/* NULL if the procedure is not available to the calling thread */
+static s7_pointer call_proc(OPCALL *p) {
+  int32_t i, slot = op_slot(p->ctx, p->frames, p->nslots);
+  s7_pointer frame, argp, res;
+  s7_scheme *s7;
+  PROFT t;
+  bool prof = prof_on(p->ctx, p->prof);
+  if(slot < 0) return NULL;
+  s7 = slot_interp(p->ctx, slot);
+  frame = p->frames[slot].obj;
+  if(prof) prof_start(p->ctx, slot, &t);
+  /* only new values need a new real */
+  for(i = 0, argp = s7_cdr(frame); s7_is_pair(argp);
+      i++, argp = s7_cdr(argp))
+    if(s7_real(s7_car(argp)) != (s7_double) *p->args[i])
+      s7_set_car(argp, s7_make_real(s7, *p->args[i]));
+  res = s7_call(s7, s7_car(frame), s7_cdr(frame));
+  if(prof) prof_end(p->ctx, p->prof, slot, &t);
+  return res;
+}
+
+static int32_t call_myflt(CSOUND *csound, OPCALL *p) {
+  s7_pointer res;
+  if(!rt_ok(p->ctx)) return OK;
+  if((res = call_proc(p)) != NULL) *((MYFLT *) p->out) = to_myflt(res);
+  return OK;
+}
+
+static int32_t call_init_myflt(CSOUND *csound, OPCALL *p) {
+  if(call_init(csound, p) != OK) return NOTOK;
+  return call_myflt(csound, p);
+}
+
+static int32_t call_obj(CSOUND *csound, OPCALL *p) {
+  s7_pointer res;
+  if(!rt_ok(p->ctx)) return OK;
+  if((res = call_proc(p)) != NULL) p->out->obj = res;
+  return OK;
+}
+
+static int32_t call_init_obj(CSOUND *csound, OPCALL *p) {
+  if(call_init(csound, p) != OK) return NOTOK;
+  return call_obj(csound, p);
+}
+
+/* time-budgeted tasks: the code runs as a thunk and calls
+   (s7-yield) at points where it may be suspended. Once the
+   k-cycle budget is spent, s7-yield escapes with its continuation,
+   which is resumed in the next cycle. Code running past the
+   limit without yielding is aborted by the begin hook.
+   Each cycle is a separate s7_call, and every way out of the
+   thunk goes through *s7task-escape*, which is set to the escape
+   of the current call before the task runs, so no call returns
+   through the C frames of an earlier one. For example, with a
+   thunk (lambda () (s7-yield) 1):
+     cycle 1: (*s7task-start* thunk) -> s7-yield escapes with k,
+              so s7_call returns the procedure k (suspended)
+     cycle 2: (*s7task-resume* k) -> (k #f) returns from s7-yield,
+              the thunk returns 1 into the *s7task-start* frame
+              captured in k, which escapes with (*s7task-done* 1)
+              through the new escape, so s7_call returns that */
+static const char *task_prelude =
+  "(define *s7task-escape* #f)\n"
+  "(define (s7-yield)\n"
+  "  (if (*s7task-over?*)\n"
+  "      (call/cc (lambda (k) (*s7task-escape* k)))\n"
+  "      #f))\n"
+  "(define (*s7task-start* thunk)\n"
+  "  (call/cc (lambda (esc)\n"
+  "    (set! *s7task-escape* esc)\n"
+  "    (let ((v (thunk)))\n"
+  "      (*s7task-escape* (list '*s7task-done* v))))))\n"
+  "(define (*s7task-resume* k)\n"
+  "  (call/cc (lambda (esc)\n"
+  "    (set! *s7task-escape* esc)\n"
+  "    (k #f))))\n";
+
+static _Thread_local uint64_t task_yield_at = 0, task_abort_at = 0;
+static _Thread_local bool task_aborted = false;
+
+static s7_pointer task_over(s7_scheme *sc, s7_pointer args) {
+  return s7_make_boolean(sc, task_yield_at != 0 && now_ns() > task_yield_at);
+}
+
+static void task_hook(s7_scheme *sc, bool *val) {
+  if(now_ns() > task_abort_at) {
+    task_aborted = true;
+    *val = true;
+  }
+}
+
+enum { TASK_NEW = 0, TASK_SUSPENDED, TASK_DONE, TASK_ABORTED };
+
+typedef struct {
+  OPDS h;
+  MYFLT *state;
+  S7OBJ *res;
+  STRINGDAT *code;
+  MYFLT *budget, *limit;
+  s7_scheme *s7;
+  S7CTX *ctx;
+  AUXCH aux;
+  SLOTOBJ *k;     /* thunk in each interpreter, then continuation */
+  int32_t nslots; /* or result in the one the task runs in (slot) */
+  int32_t slot, st;
+  S7PROF *prof;
+} OPTASK;
+
+static void task_keep(OPTASK *p, s7_pointer obj) {
+  slot_keep(p->ctx, p->k, p->slot, obj);
+}
+
+static int32_t task_deinit(CSOUND *csound, OPTASK *p) {
+  if(p->ctx != NULL) slots_free(p->ctx, p->k, p->nslots);
+  return OK;
+}
+
+/* the task thunk is made in every interpreter, and the task
+   then runs in the interpreter of the thread that starts it */
+static int32_t task_init(CSOUND *csound, OPTASK *p) {
+  int32_t i;
+  op_ctx(csound, &p->ctx, &p->s7);
+  task_deinit(csound, p);
+  if(!rt_ok(p->ctx))
+    return csound->InitError(csound, "s7task: s7 pool exhausted");
+  if(*p->budget <= FL(0.0))
+    return csound->InitError(csound, "s7task: budget must be positive");
+  p->k = slots_alloc(csound, p->ctx, &p->aux, &p->nslots);
+  for(i = 0; i < p->nslots; i++) {
+    s7_scheme *s7 = slot_interp(p->ctx, i);
+    s7_pointer form;
+    if(!s7_is_procedure(s7_name_to_value(s7, "*s7task-start*"))) {
+      s7_define_function(s7, "*s7task-over?*", task_over, 0, 0, false,
+                         "(*s7task-over?*) is #t if the task budget is spent");
+      s7_eval_c_string(s7, task_prelude);
+    }
+    form = code_form(csound, s7, (const char*) p->code->data);
+    slot_keep(p->ctx, p->k, i,
+              s7_eval(s7, s7_list(s7, 3, s7_make_symbol(s7, "lambda"),
+                                  s7_nil(s7), form), s7_rootlet(s7)));
+  }
+  p->slot = -1;
+  p->prof = prof_find(csound, p->ctx, &p->h, "s7task",
+                      (const char*) p->code->data);
+  p->st = TASK_NEW;
+  p->res->obj = NULL;
+  *p->state = FL(0.0);
+  return OK;
+}
+
+static int32_t task_perf(CSOUND *csound, OPTASK *p) {
+  s7_pointer res;
+  uint64_t t = now_ns(), budget = (uint64_t) (*p->budget*1000000);
+  uint64_t limit = *p->limit > FL(0.0) ?
+    (uint64_t) (*p->limit*1000000) : 4*budget;
+  PROFT pt;
+  bool prof = prof_on(p->ctx, p->prof);
+  int32_t slot;
+  s7_scheme *s7;
+  void (*hook)(s7_scheme *sc, bool *val);
+  if(p->st >= TASK_DONE || !rt_ok(p->ctx)) return OK;
+  /* a started task only advances in the thread it runs in */
+  slot = thread_slot(p->ctx);
+  if(p->st == TASK_NEW) {
+    if(op_slot(p->ctx, p->k, p->nslots) < 0) return OK;
+    p->slot = slot;
+  }
+  else if(slot != p->slot) return OK;
+  s7 = slot_interp(p->ctx, p->slot);
+  if(prof) prof_start(p->ctx, p->slot, &pt);
+  task_yield_at = t + budget;
+  task_abort_at = t + limit;
+  task_aborted = false;
+  /* any hook already in place is restored afterwards */
+  hook = s7_begin_hook(s7);
+  s7_set_begin_hook(s7, task_hook);
+  res = s7_call(s7, s7_name_to_value(s7, p->st == TASK_NEW ?
+                                     "*s7task-start*" :
+                                     "*s7task-resume*"),
+                s7_cons(s7, p->k[p->slot].obj, s7_nil(s7)));
+  s7_set_begin_hook(s7, hook);
+  task_yield_at = 0;
+  if(prof) prof_end(p->ctx, p->prof, p->slot, &pt);
+  if(task_aborted) {
+    p->st = TASK_ABORTED;
+    *p->state = -FL(1.0);
+    task_keep(p, NULL);
+    csound->Warning(csound, "s7task: aborted after %.3f ms without yielding "
+                    "(%s)", limit*1e-6, (const char*) p->code->data);
+  }
+  else if(s7_is_pair(res) &&
+          s7_is_eq(s7_car(res), s7_make_symbol(s7, "*s7task-done*"))) {
+    p->st = TASK_DONE;
+    *p->state = FL(1.0);
+    task_keep(p, s7_cadr(res));
+    p->res->obj = p->k[p->slot].obj;
+  }
+  else if(s7_is_procedure(res)) {
+    p->st = TASK_SUSPENDED;
+    task_keep(p, res);
+  }
+  else {
+    /* the code raised an error */
+    p->st = TASK_ABORTED;
+    *p->state = -FL(1.0);
+    task_keep(p, NULL);
+    csound->Warning(csound, "s7task: failed (%s)",
+                    (const char*) p->code->data);
+  }
+  return OK;
+}
+
+typedef struct {
+  OPDS h;
+  MYFLT *out;
+  STRINGDAT *name;
+  RAMPLANE *lane;
+  uint32_t pos;  /* of a local ksmps cycle in the engine block */
+} OPRAMP;
+
+/* the lane block is (re)allocated here, on the engine thread,
+   and filled with the current value until it is next rendered */
+static int32_t ramp_init(CSOUND *csound, OPRAMP *p) {
+  S7CTX *ctx = get_ctx(csound);
+  uint32_t n, size = csound->GetKsmps(csound);
+  const char *name = (const char *) p->name->data;
+  RAMPLANE *lane;
+  if(strlen(name) >= RAMP_NAME)
+    return csound->InitError(csound, "s7ramp: lane name longer than %d "
+                             "characters", RAMP_NAME - 1);
+  if((lane = p->lane = lane_find(ctx, name, true)) == NULL)
+    return csound->InitError(csound, "s7ramp: too many lanes");
+  if(lane->size != size) {
+    if(lane->buf != NULL) csound->Free(csound, lane->buf);
+    lane->buf = (MYFLT *) csound->Calloc(csound, size*sizeof(MYFLT));
+    for(n = 0; n < size; n++) lane->buf[n] = (MYFLT) lane->value;
+    lane->size = size;
+  }
+  p->pos = 0;
+  return OK;
+}
+
+/* with a local ksmps, the instance runs several cycles per
+   engine block, each reading the next part of the lane block */
+static inline uint32_t ramp_pos(OPRAMP *p) {
+  uint32_t pos = p->pos;
+  p->pos = (pos + CS_KSMPS) % p->lane->size;
+  return pos;
+}
+
+static int32_t ramp_perf_k(CSOUND *csound, OPRAMP *p) {
+  RAMPLANE *lane = p->lane;
+  *p->out = lane->buf[ramp_pos(p) + CS_KSMPS - 1];
+  return OK;
+}
+
+static int32_t ramp_perf_a(CSOUND *csound, OPRAMP *p) {
+  RAMPLANE *lane = p->lane;
+  uint32_t offset = p->h.insdshead->ksmps_offset;
+  uint32_t early = p->h.insdshead->ksmps_no_end;
+  uint32_t n, nsmps = CS_KSMPS, pos = ramp_pos(p);
+  if(UNLIKELY(offset)) memset(p->out, '\0', offset*sizeof(MYFLT));
+  if(UNLIKELY(early)) {
+    nsmps -= early;
+    memset(&p->out[nsmps], '\0', early*sizeof(MYFLT));
+  }
+  for(n = offset; n < nsmps; n++) p->out[n] = lane->buf[pos + n];
+  return OK;
+}
+
+/* asynchronous evaluation: the code is run by the background
+   worker (in its own interpreter) at init-time and whenever the
+   trigger is non-zero, if no job is pending. The result is passed
+   back as text and read in the engine interpreter. */
+typedef struct {
+  OPDS h;
+  MYFLT *ready;
+  S7OBJ *res;
+  STRINGDAT *code;
+  MYFLT *trig;
+  s7_scheme *s7;
+  S7CTX *ctx;
+  S7JOB *job;
+  AUXCH aux;
+  SLOTOBJ *objs;   /* result, read in the interpreter of the */
+  int32_t nslots;  /* thread that collects it */
+} OPASYNC;
+
+static int32_t async_deinit(CSOUND *csound, OPASYNC *p) {
+  S7JOB *job = p->job;
+  if(p->ctx != NULL) slots_free(p->ctx, p->objs, p->nslots);
+  p->job = NULL;
+  while(job != NULL) {
+    int32_t state = atomic_load(&job->state);
+    if(state == JOB_QUEUED || state == JOB_RUNNING) {
+      if(atomic_compare_exchange_strong(&job->state, &state, JOB_ABANDONED))
+        break;
+    }
+    else {
+      free(job->result);
+      free(job);
+      break;
+    }
+  }
+  return OK;
+}
+
+static void async_submit(OPASYNC *p) {
+  atomic_store(&p->job->state, JOB_QUEUED);
+  mpsc_push(&p->ctx->async.jobs, &p->job->node);
+  *p->ready = FL(0.0);
+}
+
+static int32_t async_init(CSOUND *csound, OPASYNC *p) {
+  size_t len = strlen((const char*) p->code->data) + 1;
+  op_ctx(csound, &p->ctx, &p->s7);
+  async_deinit(csound, p);
+  if(!async_start(csound, p->ctx))
+    return csound->InitError(csound, "s7async: could not start worker");
+  p->objs = slots_alloc(csound, p->ctx, &p->aux, &p->nslots);
+  p->job = (S7JOB *) calloc(1, sizeof(S7JOB) + len);
+  memcpy(p->job->code, p->code->data, len);
+  p->res->obj = NULL;
+  async_submit(p);
+  return OK;
+}
+
+static int32_t async_perf(CSOUND *csound, OPASYNC *p) {
+  S7JOB *job = p->job;
+  int32_t state = atomic_load_explicit(&job->state, memory_order_acquire);
+  int32_t slot = thread_slot(p->ctx);
+  if(state == JOB_DONE && slot >= 0 && slot < p->nslots && rt_ok(p->ctx)) {
+    slot_keep(p->ctx, p->objs, slot,
+              read_text(slot_interp(p->ctx, slot), job->result));
+    atomic_store(&job->state, state = JOB_IDLE);
+    p->res->obj = p->objs[slot].obj;
+    *p->ready = FL(1.0);
+  }
+  else if(state == JOB_FAILED) {
+    csound->Warning(csound, "s7async: unreadable result %s", job->result);
+    atomic_store(&job->state, state = JOB_IDLE);
+    *p->ready = FL(-1.0);
+  }
+  if(*p->trig != FL(0.0) && state == JOB_IDLE) async_submit(p);
+  return OK;
+}
+
+typedef struct {
+  OPDS h;
+  MYFLT *out;
+  STRINGDAT *name;
+  MYFLT *in;
+  s7_scheme *s7;
+  S7CTX *ctx;
+  AUXCH aux;
+  SLOTOBJ *frames;  /* (proc in-vector out-vector) in each interpreter */
+  int32_t nslots;
+  S7PROF *prof;
+} OPDSP;
+
+static int32_t dsp_deinit(CSOUND *csound, OPDSP *p) {
+  if(p->ctx != NULL) slots_free(p->ctx, p->frames, p->nslots);
+  return OK;
+}
+
+/* the in and out vectors belong to s7 (the procedure may keep
+   them beyond the instance) and are copied each cycle; a frame
+   is made in every interpreter defining the procedure */
+static int32_t dsp_init(CSOUND *csound, OPDSP *p) {
+  const char *name = (const char *) p->name->data;
+  s7_int nsmps = CS_KSMPS;
+  int32_t i;
+  op_ctx(csound, &p->ctx, &p->s7);
+  dsp_deinit(csound, p);
+  if(!rt_ok(p->ctx))
+    return csound->InitError(csound, "s7dsp: s7 pool exhausted");
+  if(!s7_is_procedure(s7_name_to_value(p->s7, name)))
+    return csound->InitError(csound, "s7dsp: %s is not a procedure", name);
+  p->frames = slots_alloc(csound, p->ctx, &p->aux, &p->nslots);
+  for(i = 0; i < p->nslots; i++) {
+    s7_scheme *s7 = slot_interp(p->ctx, i);
+    s7_pointer proc = s7_name_to_value(s7, name), frame, vin, vout;
+    if(!s7_is_procedure(proc)) continue;
+    frame = s7_cons(s7, proc, s7_nil(s7));
+    slot_keep(p->ctx, p->frames, i, frame);
+    vin = s7_make_float_vector(s7, nsmps, 1, NULL);
+    s7_set_cdr(frame, s7_cons(s7, vin, s7_nil(s7)));
+    vout = s7_make_float_vector(s7, nsmps, 1, NULL);
+    s7_set_cdr(s7_cdr(frame), s7_cons(s7, vout, s7_nil(s7)));
+  }
+  p->prof = prof_find(csound, p->ctx, &p->h, "s7dsp", name);
+  return OK;
+}
+
+static int32_t dsp_perf(CSOUND *csound, OPDSP *p) {
+  uint32_t offset = p->h.insdshead->ksmps_offset;
+  uint32_t early = p->h.insdshead->ksmps_no_end;
+  uint32_t nsmps = CS_KSMPS;
+  int32_t slot;
+  s7_pointer frame;
+  PROFT t;
+  bool prof = prof_on(p->ctx, p->prof);
+  if(!rt_ok(p->ctx) || (slot = op_slot(p->ctx, p->frames, p->nslots)) < 0) {
+    memset(p->out, '\0', nsmps*sizeof(MYFLT));
+    return OK;
+  }
+  frame = p->frames[slot].obj;
+  copy_from_myflt(s7_float_vector_elements(s7_cadr(frame)), p->in, nsmps);
+  if(prof) prof_start(p->ctx, slot, &t);
+  s7_call(slot_interp(p->ctx, slot), s7_car(frame), s7_cdr(frame));
+  if(prof) prof_end(p->ctx, p->prof, slot, &t);
+  copy_to_myflt(p->out, s7_float_vector_elements(s7_caddr(frame)), nsmps);
+  if(UNLIKELY(offset)) memset(p->out, '\0', offset*sizeof(MYFLT));
+  if(UNLIKELY(early))
+    memset(&p->out[nsmps-early], '\0', early*sizeof(MYFLT));
+  return OK;
+}
+
+typedef struct {
+  OPDS h;
+  S7OBJ *out;
+  ARRAYDAT *in;
+  s7_scheme *s7;
+  S7CTX *ctx;
+  AUXCH aux;
+  SLOTOBJ *vecs;   /* made in the interpreter of each thread */
+  int32_t nslots;
+} OPAVEC;
+
+typedef struct {
+  OPDS h;
+  ARRAYDAT *out;
+  S7OBJ *in;
+  s7_scheme *s7;
+  S7CTX *ctx;
+} OPVECA;
+
+static int32_t array_vec_deinit(CSOUND *csound, OPAVEC *p) {
+  if(p->ctx != NULL) slots_free(p->ctx, p->vecs, p->nslots);
+  return OK;
+}
+
+/* the array data is copied in bulk into an s7 float-vector,
+   which may outlive the instance or the array; a new vector is
+   only made if the array is resized */
+static int32_t array_to_vec(CSOUND *csound, OPAVEC *p) {
+  ARRAYDAT *arr = p->in;
+  int32_t slot = thread_slot(p->ctx);
+  s7_int i, len = arr->dimensions > 0 ? 1 : 0;
+  SLOTOBJ *v;
+  if(slot < 0 || slot >= p->nslots) return OK;
+  v = &p->vecs[slot];
+  for(i = 0; i < arr->dimensions; i++) len *= arr->sizes[i];
+  if(v->obj == NULL || v->len != len) {
+    s7_scheme *s7 = slot_interp(p->ctx, slot);
+    s7_int dims[8], rank = arr->dimensions;
+    if(!rt_ok(p->ctx)) return OK;
+    if(rank < 1 || rank > 8) {
+      rank = 1;
+      dims[0] = len;
+    } else for(i = 0; i < rank; i++) dims[i] = arr->sizes[i];
+    slot_keep(p->ctx, p->vecs, slot,
+              s7_make_float_vector(s7, len, rank, dims));
+    v->len = len;
+  }
+  copy_from_myflt(s7_float_vector_elements(v->obj), arr->data, len);
+  p->out->obj = v->obj;
+  return OK;
+}
+
+static int32_t array_to_vec_init(CSOUND *csound, OPAVEC *p) {
+  op_ctx(csound, &p->ctx, &p->s7);
+  array_vec_deinit(csound, p);
+  p->vecs = slots_alloc(csound, p->ctx, &p->aux, &p->nslots);
+  return array_to_vec(csound, p);
+}
+
+static void array_ensure(CSOUND *csound, ARRAYDAT *p, int32_t size) {
+  size_t ss = sizeof(MYFLT)*size;
+  if(p->dimensions == 0) {
+    p->dimensions = 1;
+    p->sizes = (int32_t *) csound->Calloc(csound, sizeof(int32_t));
+  }
+  if(p->data == NULL || ss > p->allocated) {
+    p->data = (MYFLT *) csound->ReAlloc(csound, p->data, ss);
+    memset((char *) p->data + p->allocated, '\0', ss - p->allocated);
+    p->allocated = ss;
+  }
+  p->arrayMemberSize = sizeof(MYFLT);
+  if(p->dimensions == 1) p->sizes[0] = size;
+}
+
+/* float-vector data is copied into the array in bulk */
+static int32_t vec_to_array(CSOUND *csound, OPVECA *p) {
+  s7_pointer vec = p->in->obj;
+  s7_double *v;
+  s7_int len;
+  if(vec == NULL) return OK;
+  if(!s7_is_float_vector(vec)) return NOTOK;
+  len = s7_vector_length(vec);
+  v = s7_float_vector_elements(vec);
+  array_ensure(csound, p->out, (int32_t) len);
+#ifdef USE_DOUBLE
+  if(p->out->data != v)
+    memmove(p->out->data, v, len*sizeof(MYFLT));
+#else
+  {
+    s7_int i;
+    for(i = 0; i < len; i++) p->out->data[i] = (MYFLT) v[i];
+  }
+#endif
+  return OK;
+}
+
+static int32_t vec_to_array_init(CSOUND *csound, OPVECA *p) {
+  op_ctx(csound, &p->ctx, &p->s7);
+  if(vec_to_array(csound, p) != OK)
+    return csound->InitError(csound, "s7vector: object is not a float-vector");
+  return OK;
+}
+
+static int32_t vec_to_array_perf(CSOUND *csound, OPVECA *p) {
+  if(vec_to_array(csound, p) != OK)
+    return csound->PerfError(csound, &(p->h),
+                             "s7vector: object is not a float-vector");
   return OK;
 }
 
@@ -427,19 +3777,18 @@ typedef struct {
   S7OBJ *out;
   S7OBJ *in;
   s7_scheme *s7;
+  S7CTX *ctx;
 } OPCIO;
 
 static int32_t car(CSOUND *csound, OPCIO *p) {
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
+  op_ctx(csound, &p->ctx, &p->s7);
   if(p->in->obj)
    p->out->obj = s7_car(p->in->obj);
   return OK;
 }
 
 static int32_t cdr(CSOUND *csound, OPCIO *p) {
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
+  op_ctx(csound, &p->ctx, &p->s7);
   if(p->in->obj)
    p->out->obj = s7_cdr(p->in->obj);
   return OK;
@@ -447,8 +3796,7 @@ static int32_t cdr(CSOUND *csound, OPCIO *p) {
 
 static int32_t real(CSOUND *csound, OPCIO *p) {
   MYFLT *out = (MYFLT *) p->out;
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
+  op_ctx(csound, &p->ctx, &p->s7);
   if(p->in->obj)
   *out = s7_real(p->in->obj);
   else *out = 0.;
@@ -456,9 +3804,35 @@ static int32_t real(CSOUND *csound, OPCIO *p) {
 }
 
 static int32_t make_real(CSOUND *csound, OPCIO *p) {
-  if(p->s7 == NULL)
-    p->s7 = *((s7_scheme **) csound->QueryGlobalVariable(csound, "_S7_"));
-  p->out->obj = s7_make_real(p->s7, *((MYFLT *)p->in));
+  int32_t slot;
+  op_ctx(csound, &p->ctx, &p->s7);
+  slot = thread_slot(p->ctx);
+  if(!rt_ok(p->ctx) || slot < 0) return OK;
+  p->out->obj = s7_make_real(slot_interp(p->ctx, slot), *((MYFLT *)p->in));
+  return OK;
+}
+
+typedef struct {
+  OPDS h;
+  MYFLT *on;
+} OPPROF;
+
+/* switches profiling on (1) or off (0), or prints the report */
+static int32_t profile(CSOUND *csound, OPPROF *p) {
+  S7CTX *ctx = get_ctx(csound);
+  S7PROF *r;
+  if(*p->on >= FL(0.0)) {
+    prof_enable(ctx, *p->on > FL(0.0));
+    return OK;
+  }
+  csound->Message(csound, "s7 profile:\n"
+                  "instr\topcode\tcalls\ttotal(s)\tmax(s)\tcells\tcode\n");
+  for(r = atomic_load(&ctx->prof); r != NULL; r = r->next)
+    csound->Message(csound, "%d\t%s\t%llu\t%.6f\t%.6f\t%llu\t%s\n",
+                    r->insno, r->opname,
+                    (unsigned long long) atomic_load(&r->calls),
+                    atomic_load(&r->ns)*1e-9, atomic_load(&r->max_ns)*1e-9,
+                    (unsigned long long) atomic_load(&r->cells), r->code);
   return OK;
 }
 
@@ -480,19 +3854,58 @@ int32_t append_opcodes(CSOUND *csound, s7_scheme *s7) {
   int32_t res;
   add_s7obj(csound);
   res = csound->AppendOpcode(csound, "s7definevar", sizeof(OPCI), 0,
-                           "", "Si", (SUBR) define_var_myflt, NULL, NULL);
+                           "", "Si", (SUBR) define_var_myflt_init,
+                              NULL, NULL);
   res += csound->AppendOpcode(csound, "s7eval", sizeof(OPCO), 0,
-                           "i", "S", (SUBR) interp_call_myflt, NULL, NULL);
+                           "i", "S", (SUBR) interp_init_myflt, NULL, NULL);
   res += csound->AppendOpcode(csound, "s7definevar", sizeof(OPCI), 0,
-                          "", "Sk", NULL, (SUBR) define_var_myflt, NULL);
+                          "", "Sk", (SUBR) define_init,
+                              (SUBR) define_var_myflt, (SUBR) define_deinit);
   res += csound->AppendOpcode(csound, "s7eval", sizeof(OPCO), 0,
-                             "k", "S", NULL, (SUBR) interp_call_myflt, NULL);
+                             "k", "S", (SUBR) interp_init,
+                              (SUBR) interp_call_myflt, NULL);
   res += csound->AppendOpcode(csound, "s7eval", sizeof(OPCO), 0,
-                             ":S7obj;", "S", (SUBR) interp_call,
+                             ":S7obj;", "S", (SUBR) interp_init_call,
                               (SUBR) interp_call, NULL);
   res += csound->AppendOpcode(csound, "s7definevar", sizeof(OPCI), 0,
-                            "", "S:S7obj;", (SUBR) define_var,
-                              (SUBR) define_var, NULL);
+                            "", "S:S7obj;", (SUBR) define_var_init,
+                              (SUBR) define_var, (SUBR) define_deinit);
+  res += csound->AppendOpcode(csound, "s7call", sizeof(OPCALL), 0,
+                              "i", "Sm", (SUBR) call_init_myflt, NULL,
+                              (SUBR) call_deinit);
+  res += csound->AppendOpcode(csound, "s7call", sizeof(OPCALL), 0,
+                              "k", "Sz", (SUBR) call_init,
+                              (SUBR) call_myflt, (SUBR) call_deinit);
+  res += csound->AppendOpcode(csound, "s7call", sizeof(OPCALL), 0,
+                              ":S7obj;", "Sz", (SUBR) call_init_obj,
+                              (SUBR) call_obj, (SUBR) call_deinit);
+  res += csound->AppendOpcode(csound, "s7task", sizeof(OPTASK), 0,
+                              "k:S7obj;", "Sio", (SUBR) task_init,
+                              (SUBR) task_perf, (SUBR) task_deinit);
+  res += csound->AppendOpcode(csound, "s7async", sizeof(OPASYNC), 0,
+                              "k:S7obj;", "SO", (SUBR) async_init,
+                              (SUBR) async_perf, (SUBR) async_deinit);
+  res += csound->AppendOpcode(csound, "s7ramp", sizeof(OPRAMP), 0,
+                              "k", "S", (SUBR) ramp_init,
+                              (SUBR) ramp_perf_k, NULL);
+  res += csound->AppendOpcode(csound, "s7ramp", sizeof(OPRAMP), 0,
+                              "a", "S", (SUBR) ramp_init,
+                              (SUBR) ramp_perf_a, NULL);
+  res += csound->AppendOpcode(csound, "s7dsp", sizeof(OPDSP), 0,
+                              "a", "Sa", (SUBR) dsp_init,
+                              (SUBR) dsp_perf, (SUBR) dsp_deinit);
+  res += csound->AppendOpcode(csound, "s7vector", sizeof(OPAVEC), 0,
+                              ":S7obj;", "i[]", (SUBR) array_to_vec_init,
+                              NULL, (SUBR) array_vec_deinit);
+  res += csound->AppendOpcode(csound, "s7vector", sizeof(OPAVEC), 0,
+                              ":S7obj;", "k[]", (SUBR) array_to_vec_init,
+                              (SUBR) array_to_vec, (SUBR) array_vec_deinit);
+  res += csound->AppendOpcode(csound, "s7vector", sizeof(OPVECA), 0,
+                              "i[]", ":S7obj;", (SUBR) vec_to_array_init,
+                              NULL, NULL);
+  res += csound->AppendOpcode(csound, "s7vector", sizeof(OPVECA), 0,
+                              "k[]", ":S7obj;", (SUBR) vec_to_array_init,
+                              (SUBR) vec_to_array_perf, NULL);
   res += csound->AppendOpcode(csound, "s7car", sizeof(OPCIO), 0,
                              ":S7obj;", ":S7obj;", (SUBR) car, (SUBR) car,
                               NULL);
@@ -507,22 +3920,60 @@ int32_t append_opcodes(CSOUND *csound, s7_scheme *s7) {
                              ":S7obj;", "i", (SUBR) make_real, NULL, NULL);
   res += csound->AppendOpcode(csound, "s7real", sizeof(OPCIO), 0,
                              ":S7obj;", "k", NULL, (SUBR) make_real, NULL);
+  res += csound->AppendOpcode(csound, "s7profile", sizeof(OPPROF), 0,
+                             "", "j", (SUBR) profile, NULL, NULL);
   if(s7 != NULL)
     res += save_to_global(csound, s7);  
+  res += ctx_create(csound);
   return res;
 }
 
+/* module options: -+s7_heap_size=cells -+s7_gc_budget=ms
+   -+s7_rt_pool=cells */
+typedef struct {
+  int32_t heap_size;
+  MYFLT gc_budget;
+  int32_t rt_pool;
+} S7CFG;
+
 int32_t csoundModuleCreate(CSOUND *csound) {
+  S7CFG *cfg;
+  if(csound->CreateGlobalVariable(csound, "_S7CFG_", sizeof(S7CFG))
+     != CSOUND_SUCCESS) return OK;
+  cfg = (S7CFG *) csound->QueryGlobalVariable(csound, "_S7CFG_");
+  csound->CreateConfigurationVariable(csound, "s7_heap_size",
+                                      &cfg->heap_size, CSOUNDCFG_INTEGER,
+                                      0, NULL, NULL,
+                                      "initial s7 heap size (cells)", NULL);
+  csound->CreateConfigurationVariable(csound, "s7_gc_budget",
+                                      &cfg->gc_budget, CSOUNDCFG_MYFLT,
+                                      0, NULL, NULL,
+                                      "s7 GC time budget per k-cycle (ms), "
+                                      "0 for normal GC", NULL);
+  csound->CreateConfigurationVariable(csound, "s7_rt_pool",
+                                      &cfg->rt_pool, CSOUNDCFG_INTEGER,
+                                      0, NULL, NULL,
+                                      "s7 real-time pool size (cells), "
+                                      "0 for no pool", NULL);
   return OK;
 }
 
 int32_t csoundModuleInit(CSOUND *csound) {
+  S7CFG *cfg;
+  int32_t res;
   if(csound->QueryGlobalVariable(csound, "_S7_") != NULL) return OK;
   if(csound->CreateGlobalVariable(csound, "_S7MOD_", 1) != CSOUND_SUCCESS) {
     return NOTOK;
   }
   if(save_to_global(csound, s7_init()) == CSOUND_SUCCESS){
-    return append_opcodes(csound, NULL);
+    if((res = append_opcodes(csound, NULL)) != OK) return res;
+    cfg = (S7CFG *) csound->QueryGlobalVariable(csound, "_S7CFG_");
+    if(cfg != NULL)
+      res = gc_setup(csound, cfg->heap_size, cfg->gc_budget, cfg->rt_pool);
+    if(res == OK) res = ipool_setup(csound);
+    /* the module interpreter only serves the engine */
+    if(res == OK) gc_perf(get_ctx(csound), true, false);
+    return res;
   }
   else return NOTOK;
 }
@@ -37,3 +37,20 @@
 #include "s7.h"
 
 int32_t cs_s7(s7_scheme *sc); 
+
+/* evaluates code on the performance thread of the engine set
+   with csound-repl-queue, returning the result as a string
+   (to be freed by the caller), or NULL if there is no such engine */
+char *cs_s7_queue_eval(const char *code);
+
+/* logs the top-level definitions in code, evaluated
+   in sc by the caller, so that they are replayed in the
+   interpreters created for multithreaded performance */
+void cs_s7_log_definitions(s7_scheme *sc, const char *code);
+
+/* renders the jobs listed in a manifest file (one .csd or .scm file
+   per line, optionally followed by an output file) on a pool of
+   worker threads, each with its own interpreter and engine (nworkers
+   <= 0 uses all cores); returns the number of failed jobs, or -1 if
+   the manifest cannot be read */
+int32_t cs_s7_batch(const char *manifest, int32_t nworkers);
@@ -47,6 +47,8 @@ static void bye() {
 
 int main(int argc, char **argv) {
   bool repl = true;
+  const char *manifest = NULL;
+  int32_t jobs = 0;
 #ifdef USE_TECLA
   GetLine *gl = new_GetLine(500, 5000);
   tp = gl;
@@ -58,6 +60,12 @@ int main(int argc, char **argv) {
       int32_t i;
       for (int32_t i = 1; i < argc; i++) {
         if(!strcmp(argv[i], "-q")) repl = false;
+        else if(!strcmp(argv[i], "--jobs")) {
+          if(argc > i+1) jobs = atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--render")) {
+          if(argc > i+1) manifest = argv[++i];
+        }
         else if(!strcmp(argv[i], "-e")) {
           if(argc > i+1){
             char *s;
@@ -65,6 +73,7 @@ int main(int argc, char **argv) {
             s = s7_object_to_c_string(s7, p);
             fprintf(stdout, "%s", s);
             free(s);
+            cs_s7_log_definitions(s7, argv[i]);
           }
         }
         else {
@@ -75,6 +84,8 @@ int main(int argc, char **argv) {
         }
       }
     }
+    if(manifest != NULL)
+      exit(cs_s7_batch(manifest, jobs) == 0 ? 0 : 1);
     if(!repl) {
           fprintf(stdout,"\n");
           fflush(stdout);
@@ -93,9 +104,16 @@ int main(int argc, char **argv) {
 #endif      
       if ((buffer[0] != '\n') ||
           (strlen(buffer) > 1)) {
-        char response[1024];
-        snprintf(response, 1024, "(write %s)", buffer);
-        s7_eval_c_string(s7, response);
+        char *res = cs_s7_queue_eval(buffer);
+        if(res != NULL) {
+          fprintf(stdout, "%s", res);
+          free(res);
+        } else {
+          char response[1024];
+          snprintf(response, 1024, "(write %s)", buffer);
+          s7_eval_c_string(s7, response);
+          cs_s7_log_definitions(s7, buffer);
+        }
       }
     }
   }
@@ -308,6 +308,31 @@ static void init_nlibc(s7_scheme *sc)
   s7_gc_unprotect_at(sc, gc_loc);
 }
 
+/* loads nrepl with its evaluation routed through csound-repl-eval,
+   so that input can be queued to a running engine */
+static void load_nrepl(s7_scheme *sc, const unsigned char *scm, size_t len) {
+  const char *from = "(eval form e)", *to = "(csound-repl-eval form e)";
+  size_t n = strlen(from), m = strlen(to), i;
+  char *src = (char *) malloc(len + m + 1);
+  for(i = 0; i + n <= len; i++)
+    if(!memcmp(scm + i, from, n)) break;
+  if(i + n <= len) {
+    memcpy(src, scm, i);
+    memcpy(src + i, to, m);
+    memcpy(src + i + m, scm + i + n, len - i - n);
+    len += m - n;
+  } else {
+    /* nrepl.scm has changed: input is no longer queued */
+    fprintf(stderr, "cs-s7: could not route nrepl evaluation through "
+            "csound-repl-eval; code will not be queued to a running "
+            "engine\n");
+    memcpy(src, scm, len);
+  }
+  src[len] = '\0';
+  s7_load_c_string(sc, src, len);
+  free(src);
+}
+
 /* cs-s7 exit function */
 static void bye() {
   if(s7) s7_free(s7);
@@ -318,6 +343,8 @@ static void bye() {
 
 int main(int argc, char **argv){
   bool repl = true;
+  const char *manifest = NULL;
+  int32_t jobs = 0;
   s7 = s7_init();
   if(cs_s7(s7) == CSOUND_SUCCESS) {
     atexit(bye);
@@ -325,6 +352,12 @@ int main(int argc, char **argv){
       int32_t i;
       for (int32_t i = 1; i < argc; i++) {
         if(!strcmp(argv[i], "-q")) repl = false;
+        else if(!strcmp(argv[i], "--jobs")) {
+          if(argc > i+1) jobs = atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--render")) {
+          if(argc > i+1) manifest = argv[++i];
+        }
         else if(!strcmp(argv[i], "-e")) {
           if(argc > i+1) {
             char *s;
@@ -332,6 +365,7 @@ int main(int argc, char **argv){
             s = s7_object_to_c_string(s7, p);
             fprintf(stdout, "%s", s);
             free(s);
+            cs_s7_log_definitions(s7, argv[i]);
           }
         }
         else {
@@ -342,6 +376,8 @@ int main(int argc, char **argv){
         }
       }
     }
+    if(manifest != NULL)
+      exit(cs_s7_batch(manifest, jobs) == 0 ? 0 : 1);
     if(!repl) {
       fprintf(stdout,"\n");
       fflush(stdout);
@@ -355,7 +391,7 @@ int main(int argc, char **argv){
     notcurses_s7_init(s7);
     fprintf(stdout, "cs-s7: Csound s7 scheme interpreter");
 #include "cs-s7-nrepl.h"
-    s7_load_c_string(s7, (const char *) nrepl_scm, nrepl_scm_len);
+    load_nrepl(s7, nrepl_scm, nrepl_scm_len);
   }
   return 0;
 }